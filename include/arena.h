@@ -0,0 +1,79 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+#include "definitions.h"
+
+/*
+ *	Every allocation from an arena is aligned to this many bytes.
+ */
+#define ARENA_ALIGN				16
+
+/*
+ *	The space an allocation of the given size takes up in an arena.
+ *	Use this to add up how large an arena needs to be.
+ */
+#define ARENA_SIZEOF(_size)		((((size_t)(_size)) + (ARENA_ALIGN - 1)) & ~((size_t)(ARENA_ALIGN - 1)))
+
+
+/*
+ *	A fixed size block of memory objects are carved out of.
+ *	Everything in the arena is freed at once.
+ */
+struct arena_t {
+	struct arena_t* next;			/* used to chain arenas together (see pool_t)	*/
+	byte* base;						/* start of the memory block					*/
+	size_t size;					/* size of the memory block						*/
+	size_t used;					/* bytes handed out so far						*/
+};
+
+
+/*
+ *	Fixed size nodes handed out from a chain of arenas
+ *	with a free list for reuse.
+ */
+struct pool_t {
+	struct arena_t* chunks;			/* arenas the nodes are carved from		*/
+	void* free_list;				/* nodes returned with pool_free()		*/
+	size_t node_size;				/* size of each node					*/
+	int nodes_per_chunk;			/* nodes in each new arena				*/
+};
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct arena_t* arena_create(size_t size);
+void* arena_alloc(struct arena_t* a, size_t size);
+void arena_free(struct arena_t* a);
+
+void pool_init(struct pool_t* p, size_t node_size, int nodes_per_chunk);
+void* pool_alloc(struct pool_t* p);
+void pool_free(struct pool_t* p, void* node);
+void pool_destroy(struct pool_t* p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ARENA_H */
@@ -0,0 +1,77 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _ATLAS_H
+#define _ATLAS_H
+
+#include "definitions.h"
+#include "md3_parse.h"
+
+/*
+ *	Texture atlases.
+ *
+ *	Every texture the parts of a character are drawn with is
+ *	packed into one texture when the character is loaded, and
+ *	the texture coordinates of its surfaces are moved to where
+ *	their texture ended up, so the whole character is drawn
+ *	with one texture bind.
+ *
+ *	Each texture has a border of ATLAS_GUTTER pixels copied from
+ *	its edges so filtering does not pick up its neighbours.  The
+ *	border halves with every mipmap level, so the atlas only has
+ *	ATLAS_MAX_MIPS of them.
+ */
+#define ATLAS_GUTTER			8
+#define ATLAS_MAX_MIPS			3
+#define ATLAS_MAX_SIZE			4096
+#define ATLAS_MAX_TEXTURES		32
+#define ATLAS_MAX_MODELS		10
+#define ATLAS_EXTENSION			".atlas"		/* appended to the .mod file for the texture name	*/
+
+/*
+ *	An atlas is built by atlas_build(), which only reads the
+ *	models and textures it is given so it can run on the thread
+ *	pool, then atlas_apply() hands it to the world and points
+ *	the surfaces at it from the GUI thread.
+ */
+struct atlas_t {
+	struct tga_t* tga;						/* the atlas (NULL = none was made)			*/
+	int width;
+	int height;
+	int num_textures;						/* packed into it							*/
+	
+	int num_models;
+	struct md3_model_t* models[ATLAS_MAX_MODELS];
+	float* st[ATLAS_MAX_MODELS];			/* texture coordinates of each model		*/
+	float* surface_st[ATLAS_MAX_MODELS][MD3_MAX_SURFACES];	/* each surface's (NULL = not in the atlas)	*/
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int atlas_build(struct atlas_t* atlas, struct md3_model_t** models, struct tga_t** textures, int num_models);
+void atlas_apply(struct atlas_t* atlas, char* name);
+void atlas_free(struct atlas_t* atlas);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ATLAS_H */
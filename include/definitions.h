@@ -50,9 +50,118 @@ extern struct world_t* g_world;
 #define USE_INTERPOLATION
 
 
+/*
+ *	Animations advance in fixed steps of this many milliseconds,
+ *	with t following the clock in between (see world_update()).
+ *	Comment this to advance them by however long each displayed
+ *	frame took instead.
+ */
+#define WORLD_UPDATE_STEP		10.0
+
+
+/*
+ *	Animations more than this many milliseconds behind the
+ *	clock (ie: nothing was drawn for a while) do not try to
+ *	catch up.
+ */
+#define WORLD_UPDATE_MAX_LAG	250.0
+
+
 typedef unsigned char byte;
 
 
+/*
+ *	Comment this to upload textures without mipmaps
+ *	(and draw them without trilinear filtering).
+ */
+#define USE_MIPMAPS
+
+
+/*
+ *	Comment this to keep textures uncompressed rather than
+ *	compressing them to BC1/BC3 (see tga_compress.h).
+ */
+#define USE_TEXTURE_COMPRESSION
+
+
+/*
+ *	Milliseconds a frame may spend uploading newly loaded
+ *	textures before the rest wait for the next frame.
+ */
+#define TEXTURE_UPLOAD_BUDGET		4.0
+
+
+/*
+ *	Bytes of textures kept in OpenGL (see world_set_texture_budget()).
+ *	Textures no model uses are dropped, least recently used first,
+ *	to stay under it.  If the textures in use do not fit either,
+ *	up to TEXTURE_MAX_LOD_BIAS of their biggest mipmap levels are
+ *	left out when they are uploaded.
+ */
+#define TEXTURE_GPU_BUDGET			(64 * 1024 * 1024)
+#define TEXTURE_MAX_LOD_BIAS		2
+
+
+/*
+ *	A texture is first uploaded from its first mipmap level no
+ *	bigger than this, so it can be drawn right away.  The bigger
+ *	levels follow one at a time as the upload budget allows.
+ */
+#define TEXTURE_PLACEHOLDER_SIZE	32
+
+
+/*
+ *	Comment this to give each part of a character its own
+ *	textures rather than packing them into one (see atlas.h).
+ */
+#define USE_TEXTURE_ATLAS
+
+
+/*
+ *	Comment this to draw models a triangle at a time in
+ *	immediate mode rather than a surface at a time from
+ *	vertex buffer objects (see md3_vbo.h).
+ */
+#define USE_VBO
+
+
+/*
+ *	Comment this to draw every part and surface of a model
+ *	rather than skipping the ones outside the view frustum.
+ */
+#define USE_FRUSTUM_CULLING
+
+
+/*
+ *	Uncomment this to keep verticies quantized (as they are in the
+ *	MD3 file) right up to the point they are interpolated rather
+ *	than decoding frames into the frame cache.
+ */
+//#define USE_QUANTIZED_VERTICES
+
+
+/*
+ *	Bytes of decoded vertex frames kept in the frame cache
+ *	(see md3_frame_cache.h) before the least recently used
+ *	frames are dropped.  The cache grows past the budget to
+ *	hold the animations being played, up to the max budget.
+ */
+#define MD3_FRAME_CACHE_BUDGET		(2 * 1024 * 1024)
+#define MD3_FRAME_CACHE_MAX_BUDGET	(32 * 1024 * 1024)
+
+
+/*
+ *	SIMD instruction sets the compiler will let us use.
+ *	Everything has a plain C fallback.
+ */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define USE_SSE2
+#endif
+#if defined(__AVX2__)
+	#define USE_AVX2
+#endif
+
+
 /*
  *	Math stuff.
  */
@@ -114,5 +223,45 @@ typedef unsigned char byte;
 	#endif
 #endif
 
+/*
+ *	Nor GL_TEXTURE_BASE_LEVEL and GL_TEXTURE_MAX_LEVEL (OpenGL 1.2).
+ */
+#ifndef GL_TEXTURE_BASE_LEVEL
+	#define GL_TEXTURE_BASE_LEVEL		0x813C
+#endif
+#ifndef GL_TEXTURE_MAX_LEVEL
+	#define GL_TEXTURE_MAX_LEVEL		0x813D
+#endif
+
+/*
+ *	Or vertex buffer objects (OpenGL 1.5).
+ */
+#ifndef GL_ARRAY_BUFFER
+	#define GL_ARRAY_BUFFER					0x8892
+	#define GL_ELEMENT_ARRAY_BUFFER			0x8893
+	#define GL_WRITE_ONLY					0x88B9
+	#define GL_STATIC_DRAW					0x88E4
+	#define GL_DYNAMIC_DRAW					0x88E8
+#endif
+
+/*
+ *	Or shaders (OpenGL 2.0).
+ */
+#ifndef GL_VERTEX_SHADER
+	#define GL_VERTEX_SHADER				0x8B31
+	#define GL_COMPILE_STATUS				0x8B81
+	#define GL_LINK_STATUS					0x8B82
+#endif
+
+/*
+ *	Old headers do not have S3TC.
+ */
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+	#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT		0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+	#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT	0x83F3
+#endif
+
 
 #endif /* _DEFINITIONS_H */
@@ -82,14 +82,21 @@ class model_widget : public QGroupBox {
 	
 	public:
 		model_widget(enum loadable_types mtype, int strips, Orientation orientation, const QString& title, QWidget* parent = 0, const char * name = 0);
+		~model_widget();
+		
+		void poll();
 	
 	public slots:
 		void load();
 	
 	private:
+		void start_load(char* file);
+		
 		enum loadable_types type;
 		QPushButton* open;
 		struct md3_model_t* model;
+		struct md3_load_plan_t* plan;			/* load running in the background	*/
+		int plan_done, plan_total;				/* progress last shown for the load	*/
 };
 
 
@@ -145,6 +152,7 @@ class opt_widget : public QGroupBox {
 		void mirror_checked();
 		void light_checked();
 		void nointerp_checked();
+		void gpu_lerp_checked();
 		void zoom_changed(int zfactor);
 		void vlights_checked();
 		void resetLights_pushed();
@@ -161,6 +169,7 @@ class opt_widget : public QGroupBox {
 		QCheckBox* lightCB;
 		QCheckBox* view_lightsCB;
 		QCheckBox* no_interpCB;
+		QCheckBox* gpu_lerpCB;
 		
 		QPushButton* reset_lights;
 		
@@ -254,6 +263,8 @@ class gui_widget : public QFrame {
 	public:
 		gui_widget(int argc, char** argv);
 		~gui_widget();
+		
+		void update_model_info();
 	
 	private:
 		QGridLayout* base_grid;
@@ -0,0 +1,115 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _MD3_COOK_H
+#define _MD3_COOK_H
+
+#include "definitions.h"
+#include "md3_parse.h"
+
+/*
+ *	Cooked models.
+ *
+ *	A cooked model (<model>.md3c next to the <model>.md3) holds
+ *	everything md3_load_model() would otherwise compute from the
+ *	MD3 file: per frame surface bounds, tag quaternions and the
+ *	textures the skin resolved to.  Verticies are kept encoded
+ *	and decoded by the frame cache, triangles and verticies in
+ *	vertex cache order (see md3_optimize.h).
+ *
+ *	The file is mapped and used in place.  The frames and each
+ *	surface's triangles start on a page boundary, every other
+ *	array on an MD3C_ALIGN boundary.
+ *
+ *	The cook is thrown away when the size or modification time of
+ *	the MD3 file changes (and its content hash no longer matches),
+ *	or when MD3C_VERSION is bumped.  Any change to the structures
+ *	stored in the cook must bump MD3C_VERSION.
+ *
+ *	The resolved textures are only used when the model is loaded
+ *	with the same .mod file, unchanged, as the cook was made with.
+ *	A cook made with one .mod file is not made again for another,
+ *	so characters sharing MD3s do not rewrite it in turn.
+ */
+#define MD3C_IDENT			(('C' << 24) + ('3' << 16) + ('D' << 8) + 'M')
+#define MD3C_VERSION		4
+#define MD3C_EXTENSION		"c"				/* appended to the MD3 file name	*/
+#define MD3C_PAGE_SIZE		4096
+#define MD3C_ALIGN			16
+#define MD3C_MAX_PATH		256
+
+#define MD3C_ALIGN_TO(_ofs, _align)		(((_ofs) + ((_align) - 1)) & ~((_align) - 1))
+
+/* none of these should be aligned */
+#pragma pack(1)
+
+struct md3c_header_t {
+	int ident;						/* MD3C_IDENT								*/
+	int version;					/* MD3C_VERSION								*/
+	int file_len;					/* length of the cooked file				*/
+	
+	unsigned int src_size;			/* MD3 file size							*/
+	unsigned int src_mtime;			/* MD3 file modification time				*/
+	unsigned int src_hash;			/* FNV-1a hash of the MD3 file				*/
+	
+	char skin_file[MD3C_MAX_PATH];	/* .mod file the textures came from ("" = none)	*/
+	unsigned int skin_hash;			/* FNV-1a hash of the .mod file				*/
+	
+	byte md3_header[MD3_SIZEOF_HEADER];	/* the MD3 header as it is in the MD3 file	*/
+	
+	int ofs_frames;					/* md3_frame_t[num_frames]					*/
+	int ofs_tags;					/* md3_tag_t[num_frames * num_tags]			*/
+	int ofs_tag_poses;				/* md3_tag_pose_t[num_frames * num_tags]	*/
+	int ofs_surfaces;				/* md3c_surface_t[num_surfaces]				*/
+} NO_ALIGN;
+
+
+struct md3c_surface_t {
+	byte md3_surface[MD3_SIZEOF_SURFACE];	/* the surface header as it is in the MD3 file	*/
+	
+	int ofs_shaders;				/* md3c_shader_t[num_shaders]				*/
+	int ofs_indices;				/* int[num_triangles * 3]					*/
+	int ofs_st;						/* float[num_verts * 2]						*/
+	int ofs_xyz;					/* short[num_frames * num_verts * 3]		*/
+	int ofs_normals;				/* unsigned short[num_frames * num_verts]	*/
+	int ofs_bounds;					/* md3_bounds_t[num_frames]					*/
+} NO_ALIGN;
+
+
+struct md3c_shader_t {
+	char name[MAX_QPATH];			/* name of shader							*/
+	int shader_index;				/* shader index number						*/
+	char texture[MD3C_MAX_PATH];	/* texture the skin resolved to ("" = none)	*/
+} NO_ALIGN;
+
+#pragma pack(8)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct md3_model_t* md3_load_cooked(char* file, char* skin_file);
+char* md3_cooked_texture(struct md3_model_t* model, int surface, int shader);
+void md3_cook_model(struct md3_model_t* model, char* file, char* skin_file, char** textures);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MD3_COOK_H */
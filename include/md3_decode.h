@@ -0,0 +1,53 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _MD3_DECODE_H
+#define _MD3_DECODE_H
+
+#include "definitions.h"
+#include "md3_parse.h"
+
+/*
+ *	The decoded normal for every possible encoded normal.
+ *
+ *	The encoded normal is a short in the form:
+ *		8 significant bits = lat
+ *		8 least sig bits = lng
+ *	so the short itself is the index into the table.
+ */
+#define MD3_NORMAL_TABLE_SIZE		(256 * 256)
+
+#define MD3_DECODE_NORMAL(_n)		(md3_normal_table[(unsigned short)(_n)])
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern float md3_normal_table[MD3_NORMAL_TABLE_SIZE][3];
+
+void md3_decode_init();
+void md3_decode_vertices(const short* xyz, const unsigned short* normals, int count, float* dst_xyz, float* dst_normals);
+void md3_lerp_vertices(const float* xyz1, const float* normals1, const float* xyz2, const float* normals2, int count, float t, float* dst_xyz, float* dst_normals);
+void md3_lerp_quantized(const short* xyz1, const unsigned short* normals1, const short* xyz2, const unsigned short* normals2, int count, float t, float* dst_xyz, float* dst_normals);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MD3_DECODE_H */
@@ -0,0 +1,73 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _MD3_FRAME_CACHE_H
+#define _MD3_FRAME_CACHE_H
+
+#include <stddef.h>
+#include "definitions.h"
+#include "md3_parse.h"
+
+/*
+ *	Frame cache.
+ *
+ *	Surfaces keep their verticies encoded as they are in the MD3 file.
+ *	A frame of a surface is decoded the first time it is needed and
+ *	kept in a cache shared by every model.  Once the cache holds more
+ *	than its budget the least recently used frames are thrown away.
+ *
+ *	The budget is at least large enough for every frame of the
+ *	animations being played, so a looping animation does not
+ *	throw out the frames it is about to play again.
+ *
+ *	The cache is only used from the GUI thread.
+ */
+
+/*
+ *	A decoded frame of a surface.
+ */
+struct md3_cached_frame_t {
+	struct md3_cached_frame_t* prev;	/* more recently used frame			*/
+	struct md3_cached_frame_t* next;	/* less recently used frame			*/
+	
+	struct md3_surface_t* surface;		/* surface the frame belongs to		*/
+	int frame;							/* frame number						*/
+	size_t size;						/* bytes allocated for this frame	*/
+	
+	float* xyz;							/* 3 coordinates per vertex			*/
+	float* normals;						/* 3 normal components per vertex	*/
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct md3_cached_frame_t* md3_surface_frame(struct md3_surface_t* sptr, int frame);
+void md3_frame_cache_prefetch(struct md3_model_t* model, int first_frame, int last_frame);
+void md3_frame_cache_drop(struct md3_surface_t* sptr);
+
+void md3_frame_cache_set_budget(size_t budget);
+size_t md3_frame_cache_budget();
+size_t md3_frame_cache_used();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MD3_FRAME_CACHE_H */
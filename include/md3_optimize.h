@@ -0,0 +1,54 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _MD3_OPTIMIZE_H
+#define _MD3_OPTIMIZE_H
+
+#include "definitions.h"
+#include "md3_parse.h"
+
+/*
+ *	Vertex cache optimization.
+ *
+ *	When a surface is loaded its triangles are reordered so the
+ *	verticies they share are still in the GPU's post-transform
+ *	vertex cache (Tom Forsyth's "Linear-Speed Vertex Cache
+ *	Optimisation"), then its verticies are renumbered in the order
+ *	the triangles first use them so they are fetched in order.
+ *	The cook keeps the new order (see md3_cook.h).
+ *
+ *	The order is measured by the average cache miss ratio (ACMR),
+ *	verticies transformed per triangle; 3.0 at worst, 0.5 at best
+ *	for a large regular mesh.
+ */
+#define MD3_OPTIMIZE_CACHE_SIZE		32		/* LRU cache triangles are ordered for	*/
+#define MD3_ACMR_CACHE_SIZE			16		/* FIFO cache the ACMR is measured with	*/
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int md3_optimize_surface(struct md3_surface_t* sptr);
+float md3_acmr(const int* indices, int num_triangles, int num_verts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MD3_OPTIMIZE_H */
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include "definitions.h"
 #include "tga.h"
+#include "thread_pool.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -61,20 +62,33 @@ extern "C"
 #define MD3_SIZEOF_VERTEX	(sizeof(short) * 4)
 
 /*
- *	Handy macro used in md3_load_list() to load an array
- *	of objects from the MD3 file into the specified destination.
+ *	Check that a block of _elements objects of _size bytes
+ *	starting at _offset lies entirely within the MD3 data
+ *	(ie: before ofs_eof) of the given model.
+ */
+#define MD3_IN_BOUNDS(_model, _offset, _elements, _size)										\
+				(((_offset) >= 0) && ((_elements) >= 0) && ((_offset) <= (_model)->ofs_eof) &&	\
+				 ((long)(_elements) <= (((_model)->ofs_eof - (long)(_offset)) / (long)(_size))))
+
+/*
+ *	Handy macro used in md3_load_model() to load an array
+ *	of objects from the MD3 file mapped in memory into the
+ *	specified destination.
+ *
+ *	The caller must have checked the range with MD3_IN_BOUNDS().
  *
  *	dest		- the pointer that will point to the array
  *	object_type	- the structure type of the array elements
  *	elements	- the number of elements in the array
  *	base		- added to offset to find where src is in memory
  *	offset		- added to base to find where src is in memory
+ *	dptr		- beginning of the file in memory
+ *	arena		- the arena the array is allocated from
  */
-#define LOAD_ARRAY(_dest, _object_type, _elements, _base, _offset, _fptr)						\
+#define LOAD_ARRAY(_dest, _object_type, _elements, _base, _offset, _dptr, _arena)				\
 				do {																			\
-					_dest = (_object_type*)malloc(sizeof(_object_type) * _elements);			\
-					fseek(_fptr, (_base + _offset), SEEK_SET);									\
-					fread(_dest, (sizeof(_object_type) * _elements), 1, _fptr);					\
+					_dest = (_object_type*)arena_alloc(_arena, sizeof(_object_type) * _elements);	\
+					memcpy(_dest, ((_dptr) + _base + _offset), (sizeof(_object_type) * _elements));	\
 				} while (0)
 
 /*
@@ -140,17 +154,38 @@ struct md3_texcoord_t {
 } NO_ALIGN;
 
 
-struct md3_vertex_t {
-	short x, y, z;					/* x-y-z vector normalized by MD3_XYZ_SCALE	*/
-	short normal;					/* normal encoded vector					*/
-	
-	float normalxyz[3];
+/*
+ *	Axis aligned bounds of a surface in one frame.
+ */
+struct md3_bounds_t {
+	struct vec3_t min_bounds;
+	struct vec3_t max_bounds;
 } NO_ALIGN;
 
 
-struct md3_surface_t {
-	struct md3_surface_t* next;		/* next surface in the list					*/
+/*
+ *	A tag orientation converted to a quaternion
+ *	(x, y, z, w in the same order as quat_t).
+ */
+struct md3_tag_pose_t {
+	float quat[4];
+	struct vec3_t origin;
+} NO_ALIGN;
+
+
+#pragma pack(8)
 
+
+/*
+ *	A surface.
+ *
+ *	Everything is kept as separate arrays so the interpolation
+ *	and draw loops stream through one kind of data at a time.
+ *	Per vertex arrays are frame-major (all verticies of frame 0,
+ *	then all verticies of frame 1, ...) and start 16 byte aligned.
+ */
+struct md3_surface_t {
+	/* as it is in the MD3 file (MD3_SIZEOF_SURFACE bytes) */
 	int ident;						/* magic number								*/
 	char name[MAX_QPATH];			/* surface name								*/
 	int flags;						/* unknown flags							*/
@@ -165,12 +200,19 @@ struct md3_surface_t {
 	int ofs_end;					/* end of surface relative offset			*/
 	
 	struct md3_shader_t* shader;		/* array of shaders						*/
-	struct md3_triangle_t* triangle;	/* array of triangles					*/
-	struct md3_texcoord_t* st;			/* array of surface textures			*/
-	struct md3_vertex_t* vertex;		/* array of vertexes					*/
-} NO_ALIGN;
-
-#pragma pack(8)
+	int* indices;						/* 3 vertex indices per triangle		*/
+	float* st;							/* 2 texture coordinates per vertex		*/
+	short* xyz;							/* 3 quantized coordinates per vertex per frame	*/
+	unsigned short* normals;			/* encoded normal per vertex per frame	*/
+	struct md3_bounds_t* bounds;		/* bounds of the surface for each frame	*/
+	
+	struct md3_cached_frame_t** cached_frames;	/* decoded frames (NULL = not decoded)	*/
+	size_t cached_cycle;				/* frame cache bytes its animation needs	*/
+	struct md3_surface_vbo_t* vbo;		/* vertex buffer objects (see md3_vbo.h)	*/
+	
+	float* posed;						/* verticies then normals in the model's pose (NULL = not made)	*/
+	unsigned int posed_serial;			/* md3_pose_t.serial posed was interpolated for	*/
+};
 
 
 /*
@@ -247,11 +289,30 @@ struct md3_anim_state_t {
 };
 
 
+/*
+ *	The pose a model was last drawn in.
+ *
+ *	The tag matrices, and the verticies of surfaces drawn in
+ *	immediate mode, are only interpolated again when it changes,
+ *	so every pass of a frame (anti-aliasing, depth of field,
+ *	mirrors) draws the pose the first pass interpolated.
+ */
+struct md3_pose_t {
+	unsigned int serial;				/* bumped whenever the pose changes (0 = never posed)	*/
+	int frame;
+	int next_frame;
+	float t;
+	float scale_factor;
+	float* tags;						/* 4x4 matrix per tag (NULL = not made)	*/
+};
+
+
 struct md3_model_t {
-	FILE* fptr;							/* file pointer							*/
+	struct arena_t* arena;				/* all memory for the model comes from here	*/
+	struct world_link_models_t* world_link;	/* node the world tracks this model with	*/
+	
 	long file_len;						/* file length in bytes					*/
-	byte* dptr;							/* beginning of file in memory			*/
-	//byte* sdptr;						/* beginning of file in memory (do not alter)	*/
+	byte* dptr;							/* beginning of file in memory (only valid while loading)	*/
 	
 	int ident;							/* md3 magic number, endianness			*/
 	int version;						/* version number of file format		*/
@@ -268,14 +329,21 @@ struct md3_model_t {
 
 	struct md3_frame_t* frames;			/* list of frames						*/
 	struct md3_tag_t* tags;				/* list of tags							*/
-	struct md3_surface_t* surface_ptr;	/* list of surfaces						*/
+	struct md3_tag_pose_t* tag_poses;	/* tags as quaternions (same order as tags)	*/
+	struct md3_surface_t* surfaces;		/* array of surfaces					*/
+	
+	byte* cooked;						/* cooked file the arrays point into, if any	*/
+	long cooked_len;					/* cooked file length in bytes			*/
+	int skinned;						/* textures were resolved from the cooked file	*/
+	float* atlas_st;					/* texture coordinates remapped into an atlas (see atlas.h)	*/
 		
 	/* custom stuff */
 	struct md3_model_t** links;			/* child model links					*/
 
-	char* model_name;					/* custom model name					*/
+	char model_name[MAX_QPATH];			/* custom model name					*/
 	enum MD3_BODY_PARTS body_part;		/* the type of body part this model is	*/
 	struct md3_anim_state_t anim_state;	/* current animation state				*/
+	struct md3_pose_t pose;				/* interpolated anim_state				*/
 	float rot[3];						/* user defined rotation on x/y/z		*/
 	float scale_factor;					/* scaling factor (after MD3_XYZ_SCALE)	*/
 	int draw_bounding_box;				/* should bounding box be rendered?		*/
@@ -284,9 +352,98 @@ struct md3_model_t {
 };
 
 
+/*
+ *	Load plan.
+ *
+ *	load_model() and load_weapon() first make a plan of every
+ *	MD3 and TGA file that has to be read.  md3_plan_run() reads
+ *	them all at once on the thread pool without touching the
+ *	world, then md3_plan_finish() binds the textures, links the
+ *	models and adds them to the world in the order of the .mod file.
+ *
+ *	md3_plan_start() does the same as md3_plan_run() in the
+ *	background; poll md3_plan_ready() and call md3_plan_finish()
+ *	from the GUI thread once it returns 1.
+ */
+#define MD3_PLAN_MAX_PARTS			10
+#define MD3_PLAN_MAX_TEXTURES		64
+#define MD3_PLAN_MAX_SKINS			64
+#define MD3_PLAN_MAX_PART_TEXTURES	8
+
+struct md3_plan_texture_t {
+	char file[1024];					/* path of the TGA (formatted for the OS)	*/
+	int cached;							/* the world already had it when planned	*/
+	struct tga_t* tga;					/* decoded by md3_plan_run()				*/
+};
+
+
+struct md3_plan_skin_t {
+	int part;							/* index into md3_load_plan_t.parts			*/
+	int texture;						/* index into md3_load_plan_t.textures		*/
+	char surface[MAX_QPATH];			/* surface the texture is for				*/
+};
+
+
+struct md3_plan_part_t {
+	struct md3_load_plan_t* plan;
+	
+	char name[64];						/* custom model name						*/
+	char file[1024];					/* MD3 file									*/
+	char texture_path_prefix[1024];		/* only used if use_prefix is set			*/
+	int use_prefix;						/* textures come from the MD3, not the skin	*/
+	enum MD3_BODY_PARTS body_part;
+	
+	struct md3_model_t* model;			/* loaded by md3_plan_run()					*/
+	
+	/* textures named in the MD3 itself (use_prefix) */
+	int num_textures;
+	struct md3_plan_texture_t textures[MD3_PLAN_MAX_PART_TEXTURES];
+};
+
+
+struct md3_load_plan_t {
+	char mod_file[1024];				/* .mod file the skin comes from ("" = none)	*/
+	char anim_file[1024];				/* animation config ("" = none)					*/
+	struct md3_anim_t anims[MD3_MAX_ANIMS];
+	int num_anims;						/* animations read by md3_plan_run()			*/
+	
+	int num_parts;
+	struct md3_plan_part_t parts[MD3_PLAN_MAX_PARTS];
+	
+	int num_textures;
+	struct md3_plan_texture_t textures[MD3_PLAN_MAX_TEXTURES];
+	
+	int num_skins;
+	struct md3_plan_skin_t skins[MD3_PLAN_MAX_SKINS];
+	
+	int started;						/* md3_plan_start() has been called			*/
+	struct thread_pool_t* pool;			/* pool the plan was started on				*/
+	struct thread_group_t group;		/* the jobs reading the files				*/
+	int jobs;							/* number of jobs in group					*/
+	int second_round;					/* md3_plan_queue_second_round() has run		*/
+	
+	int finished;						/* the models have been handed to the world	*/
+	struct md3_model_t* root;			/* first model of the .mod file				*/
+	struct md3_model_t* weapon;			/* weapon added with md3_plan_add_weapon()	*/
+	struct atlas_t* atlas;				/* built by md3_plan_run() (see atlas.h)		*/
+};
+
+
 struct md3_model_t* md3_load_model(char* file, char* texture_path_prefix);
 void md3_unload_model(struct md3_model_t* model);
 
+void md3_load_texture(struct md3_shader_t* shader, char* text_file, struct tga_t** decoded);
+
+struct md3_load_plan_t* md3_plan_create();
+int md3_plan_add_model(struct md3_load_plan_t* plan, char* file);
+int md3_plan_add_weapon(struct md3_load_plan_t* plan, char* path, char* texture_path_prefix);
+void md3_plan_run(struct md3_load_plan_t* plan, struct thread_pool_t* pool);
+void md3_plan_start(struct md3_load_plan_t* plan, struct thread_pool_t* pool);
+int md3_plan_ready(struct md3_load_plan_t* plan);
+void md3_plan_progress(struct md3_load_plan_t* plan, int* done, int* total);
+struct md3_model_t* md3_plan_finish(struct md3_load_plan_t* plan);
+void md3_plan_free(struct md3_load_plan_t* plan);
+
 struct md3_model_t* load_model(char* file);
 void unload_model(struct md3_model_t* model, int unload_weapon_link);
 
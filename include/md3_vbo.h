@@ -0,0 +1,71 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _MD3_VBO_H
+#define _MD3_VBO_H
+
+#include "definitions.h"
+#include "md3_parse.h"
+
+/*
+ *	Vertex buffer objects.
+ *
+ *	The triangles and texture coordinates of a surface are put in
+ *	OpenGL buffers the first time it is drawn.  Its verticies and
+ *	normals, interpolated for the pose it is drawn in (see
+ *	md3_lerp_vertices()), are written to a third buffer whenever
+ *	the model's pose changes (see md3_pose_t.serial), so the passes
+ *	of a frame (anti-aliasing, depth of field, mirrors) that draw
+ *	the same pose reuse it.
+ *	The whole surface is then drawn with a single glDrawElements().
+ *
+ *	With ENGINE_GPU_LERP set, every frame of the surface goes in
+ *	two more buffers, still quantized as in the MD3 file, and a
+ *	vertex shader decodes and interpolates the two frames being
+ *	drawn (see md3_vbo_draw_gpu()).  Nothing is written per pose.
+ *
+ *	Only used from the GUI thread (it needs the GL context).
+ */
+struct md3_surface_vbo_t {
+	unsigned int context;			/* md3_vbo_lost() count the buffers were made in	*/
+	unsigned int gl_indices;		/* 3 unsigned shorts per triangle				*/
+	unsigned int gl_st;				/* 2 texture coordinates per vertex				*/
+	unsigned int gl_verts;			/* 3 coordinates per vertex, then 3 normal components per vertex	*/
+	unsigned int gl_frame_xyz;		/* 3 quantized coordinates per vertex per frame (0 = not made)	*/
+	unsigned int gl_frame_normals;	/* encoded normal per vertex per frame			*/
+	
+	unsigned int posed_serial;		/* md3_pose_t.serial gl_verts holds (0 = none)	*/
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int md3_vbo_supported();
+int md3_vbo_shaders_supported();
+int md3_vbo_draw(struct md3_surface_t* sptr, int frame, int next_frame, float t, unsigned int serial, int textured);
+int md3_vbo_draw_gpu(struct md3_surface_t* sptr, int frame, int next_frame, float t, int textured);
+void md3_vbo_drop(struct md3_surface_t* sptr);
+void md3_vbo_lost();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MD3_VBO_H */
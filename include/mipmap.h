@@ -0,0 +1,48 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _MIPMAP_H
+#define _MIPMAP_H
+
+#include "definitions.h"
+#include "tga.h"
+
+/*
+ *	Mipmaps.
+ *
+ *	The full chain of smaller images down to 1x1 is built on the
+ *	CPU when a texture is loaded and uploaded with the texture so
+ *	it can be drawn with trilinear filtering.
+ */
+#define MIPMAP_LINEAR_BITS		12
+#define MIPMAP_LINEAR_MAX		((1 << MIPMAP_LINEAR_BITS) - 1)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void mipmap_init();
+int mipmap_build(struct tga_t* tga);
+void mipmap_free(struct tga_t* tga);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MIPMAP_H */
@@ -31,12 +31,6 @@
 											v3->z = (v1->z + (t * (v2->z - v1->z)));	\
 										} while (0)
 
-#define LERP_NORMAL(v1, v2, t, v3)		do {																									\
-											v3->normalxyz[0] = (v1->normalxyz[0] + (t * (vptr2->normalxyz[0] - vptr1->normalxyz[0])));			\
-											v3->normalxyz[1] = (v1->normalxyz[1] + (t * (vptr2->normalxyz[1] - vptr1->normalxyz[1])));			\
-											v3->normalxyz[2] = (v1->normalxyz[2] + (t * (vptr2->normalxyz[2] - vptr1->normalxyz[2])));			\
-										} while (0)
-
 #define SCALE_VERTEX(v, factor)			do {					\
 											v->x *= factor;		\
 											v->y *= factor;		\
@@ -50,16 +50,48 @@ struct tga_header_t {
 #pragma pack(8)
 
 
+/*
+ *	Enough mipmap levels for a 65536x65536 texture.
+ */
+#define TGA_MAX_MIPS		16
+
+
+/*
+ *	Largest width or height load_tga() accepts.
+ */
+#define TGA_MAX_SIZE		8192
+
+
 /*
  *	Main TGA structure.
+ *
+ *	img is always stored top row first, left column first,
+ *	so texture coordinates can be used as they are.
+ *
+ *	Once a texture is in OpenGL its pixels are freed with
+ *	tga_free_pixels() (img is NULL) and everything else is
+ *	kept; tga_reload() reads them back if they are needed.
+ *
+ *	img may point into the file it was loaded from (mapped),
+ *	it is only ever read and released with tga_free_img().
  */
 struct tga_t {
 	struct tga_header_t header;
 	byte* img;
+	byte* mapped;					/* map_file() img is inside of, NULL if img was malloc()ed	*/
+	long mapped_len;
 	int gl_format;
 	int gl_compontents;
-	int vflip;
-	int hflip;
+	unsigned int hash;				/* of the pixels (or blocks), see tga_same()	*/
+	unsigned int digest;			/* another hash of the same, see tga_same_hash()	*/
+	int keep_pixels;				/* can not be read back in, ie: an atlas		*/
+	
+	int num_mips;					/* mipmap levels below img (see mipmap.h)	*/
+	byte* mips[TGA_MAX_MIPS];		/* each half the size of the one before		*/
+	
+	int compressed;						/* TGA_BC1 or TGA_BC3 if img holds blocks (see tga_compress.h)	*/
+	byte* blocks[TGA_MAX_MIPS + 1];		/* level 0 and each mipmap level, inside img					*/
+	int blocks_len[TGA_MAX_MIPS + 1];
 };
 
 
@@ -69,7 +101,15 @@ extern "C"
 #endif
 
 struct tga_t* load_tga(char* file);
+struct tga_t* load_tga_uncompressed(char* file);
 void free_tga(struct tga_t* tga);
+void tga_free_img(struct tga_t* tga);
+int tga_same(struct tga_t* a, struct tga_t* b);
+int tga_same_hash(struct tga_t* a, struct tga_t* b);
+void tga_hash(struct tga_t* tga);
+void tga_free_pixels(struct tga_t* tga);
+int tga_reload(struct tga_t* tga, char* file);
+long tga_gpu_size(struct tga_t* tga, int first_level);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,99 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _TGA_COMPRESS_H
+#define _TGA_COMPRESS_H
+
+#include "definitions.h"
+#include "tga.h"
+
+/*
+ *	Block compressed textures.
+ *
+ *	A texture and its mipmaps are compressed once to BC1 (DXT1)
+ *	or, if it has alpha, BC3 (DXT5) and kept in <texture>.tgac
+ *	next to the TGA file.  Every 4x4 block of pixels takes 8
+ *	bytes (BC1) or 16 bytes (BC3) rather than 48 or 64.
+ *
+ *	The blocks are uploaded as they are if OpenGL has S3TC,
+ *	otherwise they are decoded back to BGRA for the upload.
+ *
+ *	The cache is thrown away when the TGA file changes or when
+ *	TGAC_VERSION is bumped.  One whose blocks do not hash to
+ *	what was written (a damaged file) is ignored.
+ */
+#define TGAC_IDENT			(('C' << 24) + ('A' << 16) + ('G' << 8) + 'T')
+#define TGAC_VERSION		2
+#define TGAC_EXTENSION		"c"				/* appended to the TGA file name	*/
+#define TGAC_MAX_LEVELS		(TGA_MAX_MIPS + 1)
+
+/* values of tga_t::compressed */
+#define TGA_BC1				1
+#define TGA_BC3				3
+
+/* bytes per 4x4 block */
+#define TGA_BC1_BLOCK		8
+#define TGA_BC3_BLOCK		16
+
+/*
+ *	Bytes of one level of a compressed texture.
+ */
+#define TGA_COMPRESSED_SIZE(_format, _width, _height)		\
+				((((_width) + 3) / 4) * (((_height) + 3) / 4) * (((_format) == TGA_BC3) ? TGA_BC3_BLOCK : TGA_BC1_BLOCK))
+
+/* none of these should be aligned */
+#pragma pack(1)
+
+struct tgac_header_t {
+	int ident;						/* TGAC_IDENT								*/
+	int version;					/* TGAC_VERSION								*/
+	int file_len;					/* length of the cache file					*/
+	
+	unsigned int src_size;			/* size of the TGA file						*/
+	unsigned int src_mtime;			/* modification time of the TGA file		*/
+	unsigned int src_hash;			/* FNV-1a hash of the TGA file				*/
+	unsigned int blocks_hash;		/* FNV-1a hash of everything after this		*/
+	
+	int width;						/* size of level 0							*/
+	int height;
+	int depth;						/* bytes per pixel the TGA decoded to		*/
+	
+	int format;						/* TGA_BC1 or TGA_BC3						*/
+	int num_levels;					/* level 0 and every mipmap level			*/
+	int ofs_levels[TGAC_MAX_LEVELS];	/* blocks of each level					*/
+	int len_levels[TGAC_MAX_LEVELS];
+} NO_ALIGN;
+
+#pragma pack(8)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct tga_t* tga_load_compressed(char* file);
+int tga_compress(struct tga_t* tga, char* file);
+int tga_compress_in_memory(struct tga_t* tga);
+void tga_upload_compressed(struct tga_t* tga, int first_level, int last_level);
+void tga_decompress(struct tga_t* tga, int level, byte* dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TGA_COMPRESS_H */
@@ -0,0 +1,57 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+ 
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *	A job run by the thread pool.
+ */
+typedef void (*thread_job_func_t)(void* arg);
+
+/*
+ *	A group of jobs that can be waited on together.
+ *	Must be zeroed before the first job is added.
+ */
+struct thread_group_t {
+	int pending;					/* jobs added but not yet finished	*/
+};
+
+struct thread_pool_t;
+
+struct thread_pool_t* thread_pool_create(int threads);
+void thread_pool_free(struct thread_pool_t* pool);
+
+void thread_pool_add(struct thread_pool_t* pool, struct thread_group_t* group, thread_job_func_t func, void* arg);
+void thread_pool_wait(struct thread_pool_t* pool, struct thread_group_t* group);
+int thread_pool_pending(struct thread_pool_t* pool, struct thread_group_t* group);
+
+int thread_pool_threads(struct thread_pool_t* pool);
+
+int cpu_count();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _THREAD_POOL_H */
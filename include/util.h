@@ -19,6 +19,8 @@
 #ifndef _UTIL_H
 #define _UTIL_H
 
+#include <stdio.h>
+
 #ifdef WIN32
 	#include <time.h>
 #else
@@ -48,6 +50,12 @@
  */
 #define SIGN(x)				((x >= 0) ? 1 : -1)
 
+/*
+ *	How much longer than the file name the
+ *	name open_temp_file() makes can be.
+ */
+#define TEMP_FILE_EXTRA		32
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -64,6 +72,14 @@ char* str_to_lower(char* str);
 
 char* format_path_for_os(char* path);
 
+void* map_file(char* file, long* len);
+void unmap_file(void* ptr, long len);
+
+int file_stamp(char* file, unsigned int* size, unsigned int* mtime);
+FILE* open_temp_file(char* file, char* tmp_file);
+unsigned int hash_fnv1a(const void* data, long len);
+unsigned int hash_murmur3(const void* data, long len, unsigned int seed);
+
 #ifdef __cplusplus
 }
 #endif
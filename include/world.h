@@ -21,6 +21,8 @@
 
 #include "md3_parse.h"
 #include "tga.h"
+#include "arena.h"
+#include "thread_pool.h"
 
 #define X_AXIS		0
 #define Y_AXIS		1
@@ -39,6 +41,7 @@
 #define ENGINE_INTERPOLATE		0x040
 #define ENGINE_AA				0x080
 #define ENGINE_DEPTH_OF_FIELD	0x100
+#define ENGINE_GPU_LERP			0x200
 
 #define WORLD_DEFAULT_FLAGS		(RENDER_TEXTURES | ENGINE_LIGHTING | ENGINE_INTERPOLATE)
 
@@ -77,14 +80,45 @@ struct world_link_models_t {
 
 /*
  *	Linked list of TGA textures.
+ *
+ *	Textures are found by name through world_t.text_names and
+ *	by their pixels (tga_t.hash) through world_t.text_contents,
+ *	so files with identical pixels share one texture.
+ *
+ *	The nodes are allocated from world_t.text_pool and
+ *	world_t.text_name_pool WORLD_TEXTURE_POOL_CHUNK at a time.
  */
+#define WORLD_TEXTURE_POOL_CHUNK		32
+#define WORLD_TEXTURE_HASH_SIZE			256		/* must be a power of 2 */
+
+struct world_texture_name_t {
+	struct world_texture_name_t* next;		/* next in the world_t.text_names bucket	*/
+	struct world_texture_name_t* sibling;	/* next name of the same texture			*/
+	struct world_texture_t* texture;
+	unsigned int hash;
+	char* name;								/* normalized path							*/
+};
+
 struct world_texture_t {
 	struct world_texture_t* next;
+	struct world_texture_t* prev;
+	struct world_texture_t* content_next;	/* next in the world_t.text_contents bucket	*/
+	struct world_texture_name_t* names;		/* every name this texture was loaded as	*/
 	struct tga_t* text;
 	char* name;
 	int binds;						/* how many models are using this texture								*/
 	unsigned int gl_text_id;		/* the GL texture identifier; md3_surface_t.gl_text_id points to this	*/
 	int gl_text_bound;				/* is texture bound?; md3_surface_t.gl_text_bound points to this		*/
+	
+	struct world_texture_t* upload_next;	/* next texture in world_t.upload_queue	*/
+	int queued;								/* waiting in world_t.upload_queue		*/
+	
+	struct world_texture_t* lru_prev;		/* world_t.unused_texts, if unused is set	*/
+	struct world_texture_t* lru_next;
+	int unused;								/* no model uses it, kept while it fits		*/
+	long gpu_bytes;							/* bytes it takes in OpenGL					*/
+	int lod;								/* mipmap levels left out of OpenGL			*/
+	int level;								/* biggest mipmap level in OpenGL so far	*/
 };
 
 
@@ -166,6 +200,18 @@ struct world_t {
 	struct md3_model_t* root_model;			/* root model - start of render tree				*/
 	struct world_link_models_t* models;		/* array of model parts	(not needed for rendering)	*/
 	struct world_texture_t* texts;			/* array of textures								*/
+	struct pool_t text_pool;				/* where the texture nodes come from				*/
+	struct pool_t text_name_pool;			/* where the texture name nodes come from			*/
+	struct world_texture_name_t* text_names[WORLD_TEXTURE_HASH_SIZE];	/* textures by name			*/
+	struct world_texture_t* text_contents[WORLD_TEXTURE_HASH_SIZE];		/* textures by tga_t.hash	*/
+	struct world_texture_t* upload_queue;	/* textures waiting to be uploaded, oldest first	*/
+	struct world_texture_t* upload_tail;
+	struct world_texture_t* unused_texts;	/* textures no model uses, oldest first				*/
+	struct world_texture_t* unused_tail;
+	long texture_bytes;						/* bytes of textures in OpenGL						*/
+	long texture_budget;					/* most bytes of textures to keep in OpenGL			*/
+	unsigned int gl_bound_text;				/* texture id last bound, binds to it are skipped	*/
+	struct thread_pool_t* pool;				/* workers models and textures are loaded on		*/
 		
 	struct md3_anim_t anims[MD3_MAX_ANIMS];	/* animation data				*/
 		
@@ -174,6 +220,7 @@ struct world_t {
 	struct light_t light[2];				/* currently only use 1 light	*/
 
 	int flags;								/* rendering options			*/
+	double update_time;						/* clock animations were last advanced to (ms)	*/
 	
 	/* hackish */
 	unsigned int gl_box_id;					/* call list id for bounding box	*/
@@ -199,12 +246,15 @@ void world_del_model(struct world_t* wptr, struct md3_model_t* mptr);
 void world_link_model(struct world_t* wptr, struct md3_model_t* mptr);
 void world_delink_model(struct world_t* wptr, struct md3_model_t* mptr);
 
-void world_add_texture(struct world_t* wptr, struct tga_t* tptr, char* name, struct md3_shader_t* sptr);
+struct tga_t* world_add_texture(struct world_t* wptr, struct tga_t* tptr, char* name, struct md3_shader_t* sptr);
 void world_del_texture(struct world_t* wptr, struct tga_t* text);
 void world_using_texture(struct world_t* wptr, struct tga_t* text);
 void world_not_using_texture(struct world_t* wptr, struct tga_t* text);
 
 struct tga_t* world_texture_cached(struct world_t* wptr, char* name, struct md3_shader_t* sptr);
+void world_upload_textures(struct world_t* wptr, double budget);
+void world_set_texture_budget(struct world_t* wptr, long budget);
+void world_textures_lost(struct world_t* wptr);
 
 struct md3_model_t* world_get_model_by_name(char* name);
 struct md3_model_t* world_get_model_by_type(enum MD3_BODY_PARTS type);
@@ -212,7 +262,8 @@ struct md3_model_t* world_get_model_by_type(enum MD3_BODY_PARTS type);
 void set_model_animation(enum MD3_ANIMATIONS id);
 void world_stop_model_animation(int model_types);
 
-void world_tick_model(struct md3_model_t* m);
+void world_update(struct world_t* wptr);
+void world_tick_model(struct md3_model_t* m, double now);
 
 void rotate_model(enum MD3_BODY_PARTS type, int axis, float degree);
 void rotate_model_absolute(enum MD3_BODY_PARTS type, int axis, float degree);
@@ -86,6 +86,14 @@ LINK32=link.exe
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=..\src\arena.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\atlas.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\gl_widget.cpp
 # End Source File
 # Begin Source File
@@ -98,10 +106,34 @@ SOURCE=..\src\main.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\md3_cook.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\md3_decode.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\md3_frame_cache.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\md3_optimize.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\md3_parse.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\md3_vbo.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\mipmap.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\quaternion.c
 # End Source File
 # Begin Source File
@@ -114,6 +146,14 @@ SOURCE=..\src\tga.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\tga_compress.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\thread_pool.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\util.c
 # End Source File
 # Begin Source File
@@ -126,6 +166,14 @@ SOURCE=..\src\world.c
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
 # Begin Source File
 
+SOURCE=..\include\arena.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\include\atlas.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\definitions.h
 # End Source File
 # Begin Source File
@@ -138,10 +186,34 @@ SOURCE=..\include\gui.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\include\md3_cook.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\include\md3_decode.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\include\md3_frame_cache.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\include\md3_optimize.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\md3_parse.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\include\md3_vbo.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\include\mipmap.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\quaternion.h
 # End Source File
 # Begin Source File
@@ -154,6 +226,14 @@ SOURCE=..\include\tga.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\include\tga_compress.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\include\thread_pool.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\util.h
 # End Source File
 # Begin Source File
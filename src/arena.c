@@ -0,0 +1,159 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	Arena allocation.
+ *
+ *	An arena is one malloc() that many objects with the
+ *	same lifetime are carved out of, so they sit next to
+ *	each other in memory and are all released with one free().
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include "definitions.h"
+#include "arena.h"
+
+
+/*
+ *	Create an arena able to hold size bytes.
+ *	The memory is zeroed.
+ *
+ *	Returns NULL on failure.
+ */
+struct arena_t* arena_create(size_t size) {
+	struct arena_t* a = NULL;
+	size_t header = ARENA_SIZEOF(sizeof(struct arena_t));
+	
+	/* the arena structure lives at the front of its own block */
+	a = (struct arena_t*)malloc(header + size + ARENA_ALIGN);
+	if (!a)
+		return NULL;
+	memset(a, 0, header + size + ARENA_ALIGN);
+	
+	a->base = (byte*)a + header;
+	a->size = size + ARENA_ALIGN;
+	a->used = 0;
+	
+	/* malloc() may not give us ARENA_ALIGN alignment - skip to the first aligned byte */
+	a->used = (ARENA_SIZEOF((size_t)a->base) - (size_t)a->base);
+	
+	return a;
+}
+
+
+/*
+ *	Allocate size bytes from the arena.
+ *
+ *	Returns NULL if the arena is full.
+ */
+void* arena_alloc(struct arena_t* a, size_t size) {
+	void* ptr = NULL;
+	
+	size = ARENA_SIZEOF(size);
+	if (!a || (size > (a->size - a->used)))
+		return NULL;
+	
+	ptr = (a->base + a->used);
+	a->used += size;
+	
+	return ptr;
+}
+
+
+/*
+ *	Free an arena and everything allocated from it.
+ */
+void arena_free(struct arena_t* a) {
+	free(a);
+}
+
+
+/*
+ *	Initialize a pool of node_size byte nodes.
+ *	Memory is only allocated when the first node is needed.
+ */
+void pool_init(struct pool_t* p, size_t node_size, int nodes_per_chunk) {
+	memset(p, 0, sizeof(struct pool_t));
+	
+	/* a free node stores the next free node in its first bytes */
+	if (node_size < sizeof(void*))
+		node_size = sizeof(void*);
+	
+	p->node_size = ARENA_SIZEOF(node_size);
+	p->nodes_per_chunk = nodes_per_chunk;
+}
+
+
+/*
+ *	Get a zeroed node from the pool.
+ *
+ *	Returns NULL on failure.
+ */
+void* pool_alloc(struct pool_t* p) {
+	struct arena_t* chunk = NULL;
+	void* node = NULL;
+	
+	if (p->free_list) {
+		/* reuse a returned node */
+		node = p->free_list;
+		p->free_list = *(void**)node;
+	} else {
+		node = arena_alloc(p->chunks, p->node_size);
+		if (!node) {
+			/* current chunk is full, start a new one */
+			chunk = arena_create(p->node_size * p->nodes_per_chunk);
+			if (!chunk)
+				return NULL;
+			chunk->next = p->chunks;
+			p->chunks = chunk;
+			
+			node = arena_alloc(chunk, p->node_size);
+		}
+	}
+	
+	memset(node, 0, p->node_size);
+	return node;
+}
+
+
+/*
+ *	Return a node to the pool.
+ */
+void pool_free(struct pool_t* p, void* node) {
+	if (!node)
+		return;
+	*(void**)node = p->free_list;
+	p->free_list = node;
+}
+
+
+/*
+ *	Free all memory used by the pool.
+ */
+void pool_destroy(struct pool_t* p) {
+	struct arena_t* next = NULL;
+	
+	while (p->chunks) {
+		next = p->chunks->next;
+		arena_free(p->chunks);
+		p->chunks = next;
+	}
+	p->free_list = NULL;
+}
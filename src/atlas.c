@@ -0,0 +1,430 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	Texture atlases.
+ *
+ *	See atlas.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "definitions.h"
+#include "world.h"
+#include "md3_parse.h"
+#include "tga.h"
+#include "tga_compress.h"
+#include "mipmap.h"
+#include "atlas.h"
+
+/*
+ *	Where a texture goes in the atlas.
+ */
+struct atlas_cell_t {
+	struct tga_t* tga;
+	byte* pixels;					/* level 0 as BGRA						*/
+	int x;							/* where the texture (not its border)	*/
+	int y;							/* starts in the atlas					*/
+	int width;
+	int height;
+};
+
+#define ATLAS_CELL_SIZE(_size)		(((_size) + (ATLAS_GUTTER * 2) + 3) & ~3)
+
+static int atlas_pack(struct atlas_cell_t** cells, int num_cells, int width);
+static void atlas_copy(byte* atlas, int width, struct atlas_cell_t* cell);
+static struct tga_t* atlas_make_texture(byte* pixels, int width, int height, int opaque);
+
+
+/*
+ *	Pack the textures the surfaces of the given models are
+ *	drawn with into one texture and work out the texture
+ *	coordinates of the surfaces in it.
+ *
+ *	textures holds the texture of each surface of each model,
+ *	MD3_MAX_SURFACES per model (NULL = the surface has none),
+ *	with its BGRA pixels uncompressed (see load_tga_uncompressed()).
+ *	The atlas is compressed as a whole, compressing them too would
+ *	lose detail twice.  Neither the world nor OpenGL is touched
+ *	so this may run on any thread; see atlas_apply().
+ *
+ *	Nothing is made if there are less than two textures,
+ *	too many or they do not fit in ATLAS_MAX_SIZE.
+ *
+ *	Returns 1 if the atlas was made.
+ */
+int atlas_build(struct atlas_t* atlas, struct md3_model_t** models, struct tga_t** textures, int num_models) {
+	struct atlas_cell_t cells[ATLAS_MAX_TEXTURES];
+	struct atlas_cell_t* order[ATLAS_MAX_TEXTURES];
+	struct atlas_cell_t* cell = NULL;
+	struct md3_surface_t* sptr = NULL;
+	struct tga_t* tga = NULL;
+	byte* pixels = NULL;
+	float* out = NULL;
+	float s = 0;
+	float t = 0;
+	int num_cells = 0;
+	int num_verts = 0;
+	int opaque = 1;
+	int width = 0;
+	int height = 0;
+	int best_width = 0;
+	int best_height = 0;
+	int m = 0;
+	int i = 0;
+	int j = 0;
+	int v = 0;
+	
+	memset(atlas, 0, sizeof(struct atlas_t));
+	memset(cells, 0, sizeof(cells));
+	
+	if (num_models > ATLAS_MAX_MODELS)
+		return 0;
+	
+	/* every texture, once */
+	for (m = 0; m < num_models; ++m) {
+		for (i = 0; (i < models[m]->num_surfaces) && (i < MD3_MAX_SURFACES); ++i) {
+			tga = textures[(m * MD3_MAX_SURFACES) + i];
+			if (!tga)
+				continue;
+			
+			for (j = 0; (j < num_cells) && (cells[j].tga != tga); ++j)
+				;
+			if (j < num_cells)
+				continue;
+			
+			if (num_cells == ATLAS_MAX_TEXTURES)
+				return 0;
+			cells[num_cells].tga = tga;
+			cells[num_cells].width = tga->header.width;
+			cells[num_cells].height = tga->header.height;
+			order[num_cells] = &cells[num_cells];
+			++num_cells;
+		}
+	}
+	
+	if (num_cells < 2)
+		return 0;
+	
+	/* tallest first packs best on shelves */
+	for (i = 1; i < num_cells; ++i) {
+		cell = order[i];
+		for (j = i; (j > 0) && (order[j - 1]->height < cell->height); --j)
+			order[j] = order[j - 1];
+		order[j] = cell;
+	}
+	
+	/* the width giving the smallest atlas */
+	width = 4;
+	for (i = 0; i < num_cells; ++i) {
+		while (width < ATLAS_CELL_SIZE(cells[i].width))
+			width *= 2;
+	}
+	for (; width <= ATLAS_MAX_SIZE; width *= 2) {
+		height = atlas_pack(order, num_cells, width);
+		if (height && (!best_width || (((long)width * height) < ((long)best_width * best_height)))) {
+			best_width = width;
+			best_height = height;
+		}
+	}
+	if (!best_width)
+		return 0;
+	atlas_pack(order, num_cells, best_width);
+	
+	/* level 0 of every texture as BGRA */
+	for (i = 0; i < num_cells; ++i) {
+		cell = &cells[i];
+		tga = cell->tga;
+		if (!tga->img || tga->compressed || (tga->header.depth != 4))
+			goto fail;
+		
+		cell->pixels = (byte*)malloc(cell->width * cell->height * 4);
+		if (!cell->pixels)
+			goto fail;
+		memcpy(cell->pixels, tga->img, (cell->width * cell->height * 4));
+		
+		/* the space between the textures does not count */
+		for (j = 0; opaque && (j < (cell->width * cell->height)); ++j)
+			opaque = (cell->pixels[(j * 4) + 3] == 255);
+	}
+	
+	pixels = (byte*)calloc(best_width * best_height, 4);
+	if (!pixels)
+		goto fail;
+	for (i = 0; i < num_cells; ++i) {
+		atlas_copy(pixels, best_width, &cells[i]);
+		free(cells[i].pixels);
+		cells[i].pixels = NULL;
+	}
+	
+	atlas->tga = atlas_make_texture(pixels, best_width, best_height, opaque);
+	if (!atlas->tga)
+		goto fail;
+	atlas->width = best_width;
+	atlas->height = best_height;
+	atlas->num_textures = num_cells;
+	
+	/* where every surface's texture coordinates are in the atlas */
+	for (m = 0; m < num_models; ++m) {
+		atlas->models[atlas->num_models] = models[m];
+		
+		num_verts = 0;
+		for (i = 0; (i < models[m]->num_surfaces) && (i < MD3_MAX_SURFACES); ++i) {
+			if (textures[(m * MD3_MAX_SURFACES) + i])
+				num_verts += models[m]->surfaces[i].num_verts;
+		}
+		
+		/* the texture coordinates may be in a read only cook */
+		if (num_verts)
+			atlas->st[atlas->num_models] = (float*)malloc(sizeof(float) * 2 * num_verts);
+		
+		out = atlas->st[atlas->num_models];
+		for (i = 0; out && (i < models[m]->num_surfaces) && (i < MD3_MAX_SURFACES); ++i) {
+			sptr = &models[m]->surfaces[i];
+			for (j = 0; (j < num_cells) && (cells[j].tga != textures[(m * MD3_MAX_SURFACES) + i]); ++j)
+				;
+			if (j == num_cells)
+				continue;
+			cell = &cells[j];
+			
+			/* textures are clamped, so clamp here since the atlas can not */
+			for (v = 0; v < sptr->num_verts; ++v) {
+				s = sptr->st[v * 2];
+				t = sptr->st[(v * 2) + 1];
+				s = ((s < 0.0f) ? 0.0f : ((s > 1.0f) ? 1.0f : s));
+				t = ((t < 0.0f) ? 0.0f : ((t > 1.0f) ? 1.0f : t));
+				out[v * 2] = ((cell->x + (s * cell->width)) / best_width);
+				out[(v * 2) + 1] = ((cell->y + (t * cell->height)) / best_height);
+			}
+			atlas->surface_st[atlas->num_models][i] = out;
+			out += (sptr->num_verts * 2);
+		}
+		
+		++atlas->num_models;
+	}
+	
+	return 1;
+	
+fail:
+	for (i = 0; i < num_cells; ++i)
+		free(cells[i].pixels);
+	free(pixels);
+	return 0;
+}
+
+
+/*
+ *	Give an atlas made by atlas_build() to the world (named name)
+ *	and move the surfaces into it.  Called from the GUI thread
+ *	once the models have been given their own textures.
+ *
+ *	The models and the atlas own what they were given after this.
+ */
+void atlas_apply(struct atlas_t* atlas, char* name) {
+	struct md3_surface_t* sptr = NULL;
+	struct md3_shader_t shared;
+	struct md3_model_t* model = NULL;
+	struct tga_t* tga = NULL;
+	int m = 0;
+	int i = 0;
+	
+	if (!atlas->tga)
+		return;
+	
+	#ifdef _DEBUG
+	printf("Atlas \"%s\" is %ix%i for %i textures.\n", name, atlas->width, atlas->height, atlas->num_textures);
+	#endif
+	
+	/*
+	 *	Register it, the world may already have
+	 *	the same atlas and give us that one instead.
+	 */
+	memset(&shared, 0, sizeof(struct md3_shader_t));
+	tga = world_add_texture(g_world, atlas->tga, name, &shared);
+	atlas->tga = NULL;
+	
+	for (m = 0; m < atlas->num_models; ++m) {
+		model = atlas->models[m];
+		
+		for (i = 0; (i < model->num_surfaces) && (i < MD3_MAX_SURFACES); ++i) {
+			sptr = &model->surfaces[i];
+			if (!atlas->surface_st[m][i] || !sptr->shader[0].texture)
+				continue;
+			
+			sptr->st = atlas->surface_st[m][i];
+			
+			world_not_using_texture(g_world, sptr->shader[0].texture);
+			sptr->shader[0].texture = tga;
+			sptr->shader[0].gl_text_id = shared.gl_text_id;
+			sptr->shader[0].gl_text_bound = shared.gl_text_bound;
+			world_using_texture(g_world, tga);
+		}
+		
+		free(model->atlas_st);
+		model->atlas_st = atlas->st[m];
+		atlas->st[m] = NULL;
+	}
+	
+	/* the surfaces hold it now */
+	world_not_using_texture(g_world, tga);
+}
+
+
+/*
+ *	Free whatever of an atlas was not handed over by atlas_apply().
+ */
+void atlas_free(struct atlas_t* atlas) {
+	int m = 0;
+	
+	if (!atlas)
+		return;
+	
+	free_tga(atlas->tga);
+	for (m = 0; m < atlas->num_models; ++m)
+		free(atlas->st[m]);
+	free(atlas);
+}
+
+
+/*
+ *	Place the cells on shelves in an atlas of the given width,
+ *	each shelf as tall as the first (tallest) cell on it.
+ *
+ *	Returns the height of the atlas or 0 if it is too tall.
+ */
+static int atlas_pack(struct atlas_cell_t** cells, int num_cells, int width) {
+	int x = 0;
+	int y = 0;
+	int shelf = 0;
+	int i = 0;
+	
+	for (; i < num_cells; ++i) {
+		if ((x + ATLAS_CELL_SIZE(cells[i]->width)) > width) {
+			x = 0;
+			y += shelf;
+			shelf = 0;
+		}
+		
+		cells[i]->x = (x + ATLAS_GUTTER);
+		cells[i]->y = (y + ATLAS_GUTTER);
+		
+		x += ATLAS_CELL_SIZE(cells[i]->width);
+		if (ATLAS_CELL_SIZE(cells[i]->height) > shelf)
+			shelf = ATLAS_CELL_SIZE(cells[i]->height);
+	}
+	y += shelf;
+	
+	return ((y <= ATLAS_MAX_SIZE) ? y : 0);
+}
+
+
+/*
+ *	Copy a cell into the atlas with its border, which
+ *	repeats the outermost pixels of the texture.
+ */
+static void atlas_copy(byte* atlas, int width, struct atlas_cell_t* cell) {
+	byte* dst = NULL;
+	int x = 0;
+	int y = 0;
+	int sy = 0;
+	
+	for (y = -ATLAS_GUTTER; y < (cell->height + ATLAS_GUTTER); ++y) {
+		sy = ((y < 0) ? 0 : ((y >= cell->height) ? (cell->height - 1) : y));
+		dst = (atlas + ((((cell->y + y) * width) + cell->x - ATLAS_GUTTER) * 4));
+		
+		/* the left border, the row, then the right border */
+		for (x = -ATLAS_GUTTER; x < 0; ++x, dst += 4)
+			memcpy(dst, (cell->pixels + ((sy * cell->width) * 4)), 4);
+		memcpy(dst, (cell->pixels + ((sy * cell->width) * 4)), (cell->width * 4));
+		dst += (cell->width * 4);
+		for (x = 0; x < ATLAS_GUTTER; ++x, dst += 4)
+			memcpy(dst, (cell->pixels + ((((sy * cell->width) + cell->width) - 1) * 4)), 4);
+	}
+}
+
+
+/*
+ *	Make a texture of BGRA atlas pixels the same way
+ *	load_tga() would have; mipmapped and compressed.
+ *	The texture takes pixels.
+ */
+static struct tga_t* atlas_make_texture(byte* pixels, int width, int height, int opaque) {
+	struct tga_t* tga = NULL;
+#if defined(USE_TEXTURE_COMPRESSION) || defined(USE_MIPMAPS)
+	int i = 0;
+#endif
+#ifdef USE_TEXTURE_COMPRESSION
+	byte* src = NULL;
+	byte* dst = NULL;
+#endif
+	
+	tga = (struct tga_t*)malloc(sizeof(struct tga_t));
+	if (!tga)
+		return NULL;
+	memset(tga, 0, sizeof(struct tga_t));
+	
+	tga->header.image_type = 2;
+	tga->header.width = (short)width;
+	tga->header.height = (short)height;
+	tga->header.depth = 4;
+	tga->header.desc = 0x20;
+	tga->img = pixels;
+	tga->gl_format = GL_BGRA;
+	tga->gl_compontents = GL_RGBA8;
+	
+	/* there is no file to read it back in from */
+	tga->keep_pixels = 1;
+	
+	#ifdef USE_TEXTURE_COMPRESSION
+		/* without alpha it compresses to half the size */
+		if (opaque) {
+			for (i = 0, src = pixels, dst = pixels; i < (width * height); ++i, src += 4, dst += 3)
+				memmove(dst, src, 3);
+			tga->header.depth = 3;
+		}
+	#else
+	(void)opaque;	/* get rid of unused variable warning */
+	#endif
+	
+	#ifdef USE_MIPMAPS
+		mipmap_build(tga);
+		
+		/* past ATLAS_MAX_MIPS the textures bleed into each other */
+		for (i = ATLAS_MAX_MIPS; i < tga->num_mips; ++i) {
+			free(tga->mips[i]);
+			tga->mips[i] = NULL;
+		}
+		if (tga->num_mips > ATLAS_MAX_MIPS)
+			tga->num_mips = ATLAS_MAX_MIPS;
+	#endif
+	
+	#ifdef USE_TEXTURE_COMPRESSION
+		/* there is no TGA file so no cache is written */
+		if (!tga_compress_in_memory(tga) && (tga->header.depth == 3)) {
+			tga->gl_format = GL_BGR;
+			tga->gl_compontents = GL_RGB8;
+		}
+	#endif
+	
+	tga_hash(tga);
+	
+	return tga;
+}
@@ -26,6 +26,7 @@
 #include "gui.h"
 #include "gl_widget.h"
 #include "md3_parse.h"
+#include "md3_vbo.h"
 
 
 gl_widget::gl_widget(int argc, char** argv, const QGLFormat& format, QWidget* parent, const char* name, const QGLWidget* shareWidget, WFlags f)
@@ -120,6 +121,13 @@ void gl_widget::idle_cycle() {
 		this->frames++;
 	}
 	
+	/*
+	 *	Swap in any model that finished loading in the
+	 *	background now, between frames.
+	 */
+	g_gui->model->poll();
+	g_gui->weapon->poll();
+	
 	/* rerender */
 	this->updateGL();
 }
@@ -164,6 +172,13 @@ void gl_widget::initializeGL() {
 	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 	#endif
 	
+	/*
+	 *	This is called again if the GL context is made again,
+	 *	any texture or buffer in the old one has to be made again.
+	 */
+	world_textures_lost(g_world);
+	md3_vbo_lost();
+	
 	/* set background color */
 	glClearColor(g_world->env.bg_rgba[0], g_world->env.bg_rgba[1], g_world->env.bg_rgba[2], g_world->env.bg_rgba[3]);
 	
@@ -261,7 +276,12 @@ void gl_widget::paintGL() {
 		glEnable(GL_TEXTURE_2D);
 	else
 		glDisable(GL_TEXTURE_2D);
+	
+	/* get newly loaded textures into GL before they are drawn */
+	world_upload_textures(g_world, TEXTURE_UPLOAD_BUDGET);
 
+	/* animate, then draw what that left */
+	world_update(g_world);
 	render();	
 }
 
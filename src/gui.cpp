@@ -167,9 +167,7 @@ gui_widget::gui_widget(int argc, char** argv) : QFrame() {
 	this->bottom_layout->addWidget(this->model_inf);
 
 	/* set model info */
-	char buf[64];
-	sprintf(buf, "Trianges: %i     Frames: %i", g_world->model_triangles, g_world->root_model ? g_world->root_model->num_frames : 0);
-	this->model_inf->setText(buf);
+	this->update_model_info();
 
 	/*
 	 *	add a frames per second label to the bottom of the screen
@@ -188,6 +186,18 @@ gui_widget::~gui_widget() {
 }
 
 
+/*
+ *	gui_widget::update_model_info()
+ *
+ *	Show the triangle and frame count of the loaded model.
+ */
+void gui_widget::update_model_info() {
+	char buf[64];
+	sprintf(buf, "Trianges: %i     Frames: %i", g_world->model_triangles, g_world->root_model ? g_world->root_model->num_frames : 0);
+	this->model_inf->setText(buf);
+}
+
+
 /***********************************************************************************
  *
  *	model_widget
@@ -202,6 +212,7 @@ model_widget::model_widget(enum loadable_types mtype, int strips, Orientation or
 	: QGroupBox(strips, orientation, title, parent, name) {
 
 	this->model = NULL;
+	this->plan = NULL;
 	this->type = mtype;
 	
 	this->open = new QPushButton("Open", this);
@@ -215,21 +226,19 @@ model_widget::model_widget(enum loadable_types mtype, int strips, Orientation or
 		
 	/*
 	 *	Load default models if defined.
+	 *
+	 *	They are loaded in the background so the window shows
+	 *	up right away; poll() puts them in the world once loaded
+	 *	(and sets the default animations).
 	 */
 	#ifdef DEFAULT_LOAD_MODEL
 		if (mtype == MODEL_TYPE)
-			this->model = load_model(DEFAULT_LOAD_MODEL);
+			this->start_load(DEFAULT_LOAD_MODEL);
 
 		#ifdef DEFAULT_LOAD_WEAPON
 		if (mtype == WEAPON_TYPE)
-			this->model = load_weapon(DEFAULT_LOAD_WEAPON, "../");
+			this->start_load(DEFAULT_LOAD_WEAPON);
 		#endif
-
-		/*
-		 *	Set the default animations.
-		 */
-		SET_DEFAULT_ANIMATIONS();
-
 	#endif
 	#ifdef DEFAULT_LOAD_LIGHT0
 		load_light_model(DEFAULT_LOAD_LIGHT0, 0);
@@ -237,6 +246,15 @@ model_widget::model_widget(enum loadable_types mtype, int strips, Orientation or
 }
 
 
+/*
+ *	model_widget::~model_widget()
+ */
+model_widget::~model_widget() {
+	/* throw away a load still in progress */
+	md3_plan_free(this->plan);
+}
+
+
 /*
  *	model_widget::load()
  *
@@ -252,6 +270,101 @@ void model_widget::load() {
 		if (s.isEmpty())
 			return;
 
+		/* load the full model - poll() will swap it in */
+		this->start_load((char*)s.ascii());
+
+	} else {
+		/* weapon */
+		
+		/* get the file to be loaded */
+		QString s = QFileDialog::getOpenFileName(WEAPONS_PATH, "Weapon Models (*.md3)", this, 0, "Open Model File");
+		
+		if (s.isEmpty())
+			return;
+
+		/* load the weapon model - poll() will swap it in */
+		this->start_load((char*)s.ascii());
+	}
+}
+
+
+/*
+ *	model_widget::start_load()
+ *
+ *	Start loading a model or weapon in the background.
+ *	A load already in progress is thrown away.
+ */
+void model_widget::start_load(char* file) {
+	int ok = 0;
+	
+	md3_plan_free(this->plan);
+	
+	this->plan = md3_plan_create();
+	if (!this->plan)
+		return;
+	
+	if (this->type == MODEL_TYPE)
+		ok = md3_plan_add_model(this->plan, file);
+	else
+		ok = md3_plan_add_weapon(this->plan, file, "../");
+	
+	if (!ok) {
+		printf("Error: Unable to load \"%s\".\n", file);
+		md3_plan_free(this->plan);
+		this->plan = NULL;
+		return;
+	}
+	
+	this->plan_done = -1;
+	md3_plan_start(this->plan, g_world->pool);
+}
+
+
+/*
+ *	model_widget::poll()
+ *
+ *	Called by the GL widget between frames.
+ *
+ *	Once a background load has read all its files the new model
+ *	is put in the world and the old one is unloaded, all before
+ *	the next frame is rendered.
+ */
+void model_widget::poll() {
+	struct md3_model_t* weapon = NULL;
+	char buf[64];
+	int done = 0;
+	int total = 0;
+	
+	if (!this->plan)
+		return;
+	
+	if (!md3_plan_ready(this->plan)) {
+		/* only touch the label when the progress has changed */
+		md3_plan_progress(this->plan, &done, &total);
+		if ((done == this->plan_done) && (total == this->plan_total))
+			return;
+		this->plan_done = done;
+		this->plan_total = total;
+		
+		sprintf(buf, "Loading %s...  %i / %i", ((this->type == MODEL_TYPE) ? "model" : "weapon"), done, total);
+		g_gui->model_inf->setText(buf);
+		return;
+	}
+	
+	/* the selected object may be about to be unloaded */
+	if (g_gui->gl->selected_object && (g_gui->gl->selected_object->body_part != MD3_LIGHT)) {
+		g_gui->gl->selected_object->draw_bounding_box = 0;
+		g_gui->gl->selected_object = NULL;
+		g_gui->srot->object_selected(NULL);
+	}
+	
+	if (this->type == MODEL_TYPE) {
+		/*
+		 *	Add the new model to the world before the old one is removed
+		 *	so textures used by both are not freed and read again.
+		 */
+		md3_plan_finish(this->plan);
+		
 		/*
 		 *	If there was previously a model loaded unload it.
 		 *
@@ -260,12 +373,10 @@ void model_widget::load() {
 		 *	For this reason after the model has been loaded we must relink
 		 *	the weapon back into the new tree.
 		 */
-		struct md3_model_t* weapon = world_get_model_by_type(MD3_WEAPON);
+		weapon = world_get_model_by_type(MD3_WEAPON);
 		if (this->model)
 			unload_model(this->model, 0);
-			
-		/* load the full model */
-		this->model = load_model((char*)s.ascii());
+		this->model = this->plan->root;
 		
 		/* relink the weapon */
 		if (weapon)
@@ -273,27 +384,22 @@ void model_widget::load() {
 		
 		/* now that the model has been loaded the GUI animation stuff must be reset */
 		g_gui->animate->reset_animation();
-
-		char buf[64];
-		sprintf(buf, "Trianges: %i     Frames: %i", g_world->model_triangles, g_world->root_model ? g_world->root_model->num_frames : 0);
-		g_gui->model_inf->setText(buf);
-
 	} else {
-		/* weapon */
-		
-		/* get the file to be loaded */
-		QString s = QFileDialog::getOpenFileName(WEAPONS_PATH, "Weapon Models (*.md3)", this, 0, "Open Model File");
-		
-		if (s.isEmpty())
-			return;
-
-		/* if there was previously a model loaded unload it */
+		/*
+		 *	If there was previously a weapon loaded unload it first,
+		 *	otherwise the new weapon could link to the old one.
+		 */
 		if (this->model)
 			unload_weapon(this->model);
 		
-		/* load the weapon model */
-		this->model = load_weapon((char*)s.ascii(), "../");
+		md3_plan_finish(this->plan);
+		this->model = this->plan->weapon;
 	}
+	
+	md3_plan_free(this->plan);
+	this->plan = NULL;
+	
+	g_gui->update_model_info();
 }
 
 
@@ -598,7 +704,7 @@ opt_widget::opt_widget(int strips, Orientation orientation, const QString& title
 	/*
 	 *	creates a grid layout to organize the widgets
 	 */
-	this->opt_grid = new QGridLayout(this->base, 5, 2, 1, 5);
+	this->opt_grid = new QGridLayout(this->base, 6, 2, 1, 5);
 
 	/*
 	 *	first column
@@ -618,8 +724,12 @@ opt_widget::opt_widget(int strips, Orientation orientation, const QString& title
 	this->zLabel = new QLabel("Zoom In/Out", this->base);
 	this->opt_grid->addWidget(this->zLabel, 3, 0);
 	
+	this->gpu_lerpCB = new QCheckBox("GPU Interpolation", this->base);
+	this->opt_grid->addWidget(this->gpu_lerpCB, 4, 0);
+	connect( gpu_lerpCB, SIGNAL( clicked() ), this, SLOT( gpu_lerp_checked() ) );
+	
 	this->reset_lights = new QPushButton("Reset Light", this->base);
-	this->opt_grid->addMultiCellWidget(this->reset_lights, 4, 4, 0, 1);
+	this->opt_grid->addMultiCellWidget(this->reset_lights, 5, 5, 0, 1);
 	connect( reset_lights, SIGNAL( clicked() ), this, SLOT( resetLights_pushed() ) );
 
 	/*
@@ -702,6 +812,18 @@ void opt_widget::nointerp_checked() {
 		world_set_options(g_world, ENGINE_INTERPOLATE, 0);
 }
 
+/*
+ *	opt_widget::gpu_lerp_checked()
+ *
+ *	Toggle interpolating in a vertex shader.
+ */
+void opt_widget::gpu_lerp_checked() {
+	if (this->gpu_lerpCB->isChecked() == true) 
+		world_set_options(g_world, ENGINE_GPU_LERP, 0);
+	else
+		world_set_options(g_world, 0, ENGINE_GPU_LERP);
+}
+
 /*
  *	opt_widget::zoom_checked()
  *
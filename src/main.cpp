@@ -35,8 +35,8 @@ void a(struct md3_model_t* m) {
 	int i = 0;
 	for (; i < m->num_tags; ++i) {
 		printf("[%s] -> [%s]\n",
-				m->surface_ptr->name,
-				m->links[i] ? m->links[i]->surface_ptr->name : "none"
+				m->surfaces[0].name,
+				m->links[i] ? m->links[i]->surfaces[0].name : "none"
 		);
 		if (m->links[i])
 			a(m->links[i]);
@@ -2,11 +2,11 @@ TEMPLATE = app
 TARGET = md3
 CONFIG -= moc
 
-LIBS += -lGL -lGLU -lX11 -lm -L/usr/X11R6/lib
+LIBS += -lGL -lGLU -lX11 -lm -lpthread -L/usr/X11R6/lib
 
 INCPATH += ../include
 
-SOURCES += main.cpp md3_parse.c render.c util.c gui.cpp gl_widget.cpp tga.c quaternion.c world.c accum.c
+SOURCES += main.cpp md3_parse.c render.c util.c gui.cpp gl_widget.cpp tga.c quaternion.c world.c accum.c md3_decode.c arena.c md3_cook.c thread_pool.c md3_frame_cache.c mipmap.c tga_compress.c atlas.c md3_vbo.c md3_optimize.c
 
 HEADERS +=	../include/definitions.h \
 			../include/gui.h \
@@ -18,4 +18,14 @@ HEADERS +=	../include/definitions.h \
 			../include/quaternion.h \
 			../include/world.h \
 			../include/jitter.h \
-			../include/accum.h
+			../include/accum.h \
+			../include/md3_decode.h \
+			../include/arena.h \
+			../include/md3_cook.h \
+			../include/thread_pool.h \
+			../include/md3_frame_cache.h \
+			../include/mipmap.h \
+			../include/tga_compress.h \
+			../include/atlas.h \
+			../include/md3_vbo.h \
+			../include/md3_optimize.h
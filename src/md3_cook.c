@@ -0,0 +1,471 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	Cooked model files.
+ *
+ *	See md3_cook.h for the layout.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "definitions.h"
+#include "util.h"
+#include "world.h"
+#include "md3_parse.h"
+#include "md3_cook.h"
+#include "arena.h"
+
+/*
+ *	Check that a block of _elements objects of _size bytes
+ *	starting at _offset lies entirely within the cooked file.
+ */
+#define MD3C_IN_BOUNDS(_len, _offset, _elements, _size)										\
+				(((_offset) >= 0) && ((_elements) >= 0) && ((long)(_offset) <= (_len)) &&	\
+				 ((long)(_elements) <= (((_len) - (long)(_offset)) / (long)(_size))))
+
+static int md3_cook_source_matches(char* file, struct md3c_header_t* hdr);
+static int md3_cook_skin_hash(char* skin_file, unsigned int* hash);
+static size_t md3_cooked_size(struct md3_model_t* header, struct md3c_header_t* hdr, byte* dptr, long len);
+
+
+/*
+ *	Load a model from the cook of the given MD3 file.
+ *
+ *	If skin_file is the .mod file the cook was made with,
+ *	model->skinned is set and md3_cooked_texture() returns
+ *	the textures the skin resolved to.
+ *
+ *	No textures are loaded and the world is not touched,
+ *	so this is safe to call from any thread.
+ *
+ *	Returns NULL if there is no cook or it is out of date, in which
+ *	case the MD3 file has to be parsed.
+ */
+struct md3_model_t* md3_load_cooked(char* file, char* skin_file) {
+	struct md3_model_t header;
+	struct md3_model_t* model = NULL;
+	struct md3_surface_t* sptr = NULL;
+	struct md3c_header_t* hdr = NULL;
+	struct md3c_surface_t* csurf = NULL;
+	struct md3c_shader_t* cshader = NULL;
+	struct arena_t* arena = NULL;
+	unsigned int skin_hash = 0;
+	int use_skin = 0;
+	size_t size = 0;
+	int surface = 0;
+	int i = 0;
+	char cfile[1024];
+	
+	if ((strlen(file) + strlen(MD3C_EXTENSION)) >= sizeof(cfile))
+		return NULL;
+	sprintf(cfile, "%s%s", file, MD3C_EXTENSION);
+
+	memset(&header, 0, sizeof(struct md3_model_t));
+	
+	header.dptr = (byte*)map_file(cfile, &header.file_len);
+	if (!header.dptr)
+		return NULL;
+	hdr = (struct md3c_header_t*)header.dptr;
+	
+	if ((header.file_len < (long)sizeof(struct md3c_header_t)) ||
+		(hdr->ident != MD3C_IDENT) || (hdr->version != MD3C_VERSION) ||
+		(hdr->file_len != header.file_len) ||
+		!md3_cook_source_matches(file, hdr))
+	{
+		unmap_file(header.dptr, header.file_len);
+		return NULL;
+	}
+	
+	memcpy(&header.ident, hdr->md3_header, MD3_SIZEOF_HEADER);
+	
+	size = md3_cooked_size(&header, hdr, header.dptr, header.file_len);
+	if (!size) {
+		printf("WARNING: Cooked model \"%s\" is corrupt, ignoring it.\n", cfile);
+		unmap_file(header.dptr, header.file_len);
+		return NULL;
+	}
+	
+	arena = arena_create(size);
+	if (!arena) {
+		unmap_file(header.dptr, header.file_len);
+		return NULL;
+	}
+	
+	/* only use the resolved textures if the skin has not changed */
+	if (skin_file && hdr->skin_file[0] && !strncmp(skin_file, hdr->skin_file, MD3C_MAX_PATH) &&
+		md3_cook_skin_hash(skin_file, &skin_hash))
+		use_skin = (skin_hash == hdr->skin_hash);
+	
+	model = (struct md3_model_t*)arena_alloc(arena, sizeof(struct md3_model_t));
+	memcpy(model, &header, sizeof(struct md3_model_t));
+	model->arena = arena;
+	model->world_link = (struct world_link_models_t*)arena_alloc(arena, sizeof(struct world_link_models_t));
+	
+	/* the model keeps the cook mapped and uses it in place */
+	model->cooked = model->dptr;
+	model->cooked_len = model->file_len;
+	model->file_len = (long)hdr->src_size;
+	model->dptr = NULL;
+	model->skinned = use_skin;
+	
+	model->frames = (struct md3_frame_t*)(model->cooked + hdr->ofs_frames);
+	model->tags = (struct md3_tag_t*)(model->cooked + hdr->ofs_tags);
+	model->tag_poses = (struct md3_tag_pose_t*)(model->cooked + hdr->ofs_tag_poses);
+	model->links = (struct md3_model_t**)arena_alloc(arena, sizeof(struct md3_model_t*) * model->num_tags);
+	
+	if (model->num_surfaces)
+		model->surfaces = (struct md3_surface_t*)arena_alloc(arena, sizeof(struct md3_surface_t) * model->num_surfaces);
+	
+	csurf = (struct md3c_surface_t*)(model->cooked + hdr->ofs_surfaces);
+	for (; surface < model->num_surfaces; ++surface, ++csurf) {
+		sptr = &model->surfaces[surface];
+		memcpy(&sptr->ident, csurf->md3_surface, MD3_SIZEOF_SURFACE);
+		
+		sptr->indices = (int*)(model->cooked + csurf->ofs_indices);
+		sptr->st = (float*)(model->cooked + csurf->ofs_st);
+		sptr->xyz = (short*)(model->cooked + csurf->ofs_xyz);
+		sptr->normals = (unsigned short*)(model->cooked + csurf->ofs_normals);
+		sptr->cached_frames = (struct md3_cached_frame_t**)arena_alloc(arena, sizeof(struct md3_cached_frame_t*) * sptr->num_frames);
+		sptr->bounds = (struct md3_bounds_t*)(model->cooked + csurf->ofs_bounds);
+		model->total_triangles += sptr->num_triangles;
+		
+		sptr->shader = (struct md3_shader_t*)arena_alloc(arena, sizeof(struct md3_shader_t) * sptr->num_shaders);
+		cshader = (struct md3c_shader_t*)(model->cooked + csurf->ofs_shaders);
+		for (i = 0; i < sptr->num_shaders; ++i, ++cshader) {
+			memcpy(sptr->shader[i].name, cshader->name, MAX_QPATH);
+			sptr->shader[i].name[MAX_QPATH - 1] = '\0';
+			sptr->shader[i].shader_index = cshader->shader_index;
+		}
+	}
+	
+	#ifdef MD3_DEBUG
+	printf("Model \"%s\" loaded from cook \"%s\".\n", file, cfile);
+	#endif
+	
+	return model;
+}
+
+
+/*
+ *	Return the texture the skin resolved to for a shader of
+ *	a model loaded from its cook, NULL if there is none.
+ */
+char* md3_cooked_texture(struct md3_model_t* model, int surface, int shader) {
+	struct md3c_header_t* hdr = NULL;
+	struct md3c_surface_t* csurf = NULL;
+	struct md3c_shader_t* cshader = NULL;
+	
+	if (!model->cooked || !model->skinned)
+		return NULL;
+	
+	hdr = (struct md3c_header_t*)model->cooked;
+	csurf = ((struct md3c_surface_t*)(model->cooked + hdr->ofs_surfaces) + surface);
+	cshader = ((struct md3c_shader_t*)(model->cooked + csurf->ofs_shaders) + shader);
+	
+	return (cshader->texture[0] ? cshader->texture : NULL);
+}
+
+
+/*
+ *	Write the cook for a loaded model.
+ *
+ *	If skin_file is not NULL it is the .mod file the skin came
+ *	from and textures[] holds the texture it gives the first
+ *	shader of each surface (NULL entries for none).
+ *
+ *	Failing to write the cook is not an error, the
+ *	model will just be parsed again next time.
+ *
+ *	Nothing is written if the model came from a cook made
+ *	with another .mod file (see md3_cook.h).
+ */
+void md3_cook_model(struct md3_model_t* model, char* file, char* skin_file, char** textures) {
+	struct md3c_surface_t csurf[MD3_MAX_SURFACES];
+	struct md3c_header_t layout;
+	struct md3c_shader_t* cshader = NULL;
+	struct md3_surface_t* sptr = NULL;
+	FILE* fptr = NULL;
+	byte* buf = NULL;
+	byte* src = NULL;
+	long src_len = 0;
+	long ofs = 0;
+	unsigned int size = 0;
+	unsigned int mtime = 0;
+	unsigned int hash = 0;
+	int surface = 0;
+	int i = 0;
+	int ok = 0;
+	char cfile[1024];
+	char tmp_file[sizeof(cfile) + TEMP_FILE_EXTRA];
+	
+	if (!model || (model->num_surfaces > MD3_MAX_SURFACES) ||
+		((strlen(file) + strlen(MD3C_EXTENSION)) >= sizeof(cfile)))
+		return;
+	sprintf(cfile, "%s%s", file, MD3C_EXTENSION);
+	
+	if (model->cooked && ((struct md3c_header_t*)model->cooked)->skin_file[0])
+		return;
+	
+	/*
+	 *	Lay out the file.
+	 *	The small tables share the first pages, the frames and
+	 *	each surface's triangles start on a page of their own.
+	 */
+	memset(&layout, 0, sizeof(struct md3c_header_t));
+	memset(csurf, 0, sizeof(csurf));
+	
+	ofs = MD3C_ALIGN_TO(sizeof(struct md3c_header_t), MD3C_ALIGN);
+	layout.ofs_surfaces = ofs;
+	ofs += (sizeof(struct md3c_surface_t) * model->num_surfaces);
+	
+	for (surface = 0; surface < model->num_surfaces; ++surface) {
+		sptr = &model->surfaces[surface];
+		ofs = MD3C_ALIGN_TO(ofs, MD3C_ALIGN);
+		csurf[surface].ofs_shaders = ofs;
+		ofs += (sizeof(struct md3c_shader_t) * sptr->num_shaders);
+	}
+	
+	ofs = MD3C_ALIGN_TO(ofs, MD3C_PAGE_SIZE);
+	layout.ofs_frames = ofs;
+	ofs += (sizeof(struct md3_frame_t) * model->num_frames);
+	ofs = MD3C_ALIGN_TO(ofs, MD3C_ALIGN);
+	layout.ofs_tags = ofs;
+	ofs += (sizeof(struct md3_tag_t) * model->num_tags * model->num_frames);
+	ofs = MD3C_ALIGN_TO(ofs, MD3C_ALIGN);
+	layout.ofs_tag_poses = ofs;
+	ofs += (sizeof(struct md3_tag_pose_t) * model->num_tags * model->num_frames);
+	
+	for (surface = 0; surface < model->num_surfaces; ++surface) {
+		sptr = &model->surfaces[surface];
+		ofs = MD3C_ALIGN_TO(ofs, MD3C_PAGE_SIZE);
+		csurf[surface].ofs_indices = ofs;
+		ofs += (sizeof(int) * 3 * sptr->num_triangles);
+		ofs = MD3C_ALIGN_TO(ofs, MD3C_ALIGN);
+		csurf[surface].ofs_st = ofs;
+		ofs += (sizeof(float) * 2 * sptr->num_verts);
+		ofs = MD3C_ALIGN_TO(ofs, MD3C_ALIGN);
+		csurf[surface].ofs_xyz = ofs;
+		ofs += (sizeof(short) * 3 * sptr->num_verts * sptr->num_frames);
+		ofs = MD3C_ALIGN_TO(ofs, MD3C_ALIGN);
+		csurf[surface].ofs_normals = ofs;
+		ofs += (sizeof(unsigned short) * sptr->num_verts * sptr->num_frames);
+		ofs = MD3C_ALIGN_TO(ofs, MD3C_ALIGN);
+		csurf[surface].ofs_bounds = ofs;
+		ofs += (sizeof(struct md3_bounds_t) * sptr->num_frames);
+	}
+	
+	layout.ident = MD3C_IDENT;
+	layout.version = MD3C_VERSION;
+	layout.file_len = (int)ofs;
+	memcpy(layout.md3_header, &model->ident, MD3_SIZEOF_HEADER);
+	
+	src = (byte*)map_file(file, &src_len);
+	if (!src || !file_stamp(file, &size, &mtime)) {
+		unmap_file(src, src_len);
+		return;
+	}
+	layout.src_size = size;
+	layout.src_mtime = mtime;
+	layout.src_hash = hash_fnv1a(src, src_len);
+	unmap_file(src, src_len);
+	
+	if (skin_file && textures && (strlen(skin_file) < MD3C_MAX_PATH) && md3_cook_skin_hash(skin_file, &hash)) {
+		strcpy(layout.skin_file, skin_file);
+		layout.skin_hash = hash;
+	} else
+		skin_file = NULL;
+	
+	buf = (byte*)calloc(1, layout.file_len);
+	if (!buf)
+		return;
+	memcpy(buf, &layout, sizeof(struct md3c_header_t));
+	
+	/* frames, tags and tag poses */
+	memcpy(buf + layout.ofs_frames, model->frames, sizeof(struct md3_frame_t) * model->num_frames);
+	memcpy(buf + layout.ofs_tags, model->tags, sizeof(struct md3_tag_t) * model->num_tags * model->num_frames);
+	memcpy(buf + layout.ofs_tag_poses, model->tag_poses, sizeof(struct md3_tag_pose_t) * model->num_tags * model->num_frames);
+	
+	/* surfaces */
+	for (surface = 0; surface < model->num_surfaces; ++surface) {
+		sptr = &model->surfaces[surface];
+		memcpy(csurf[surface].md3_surface, &sptr->ident, MD3_SIZEOF_SURFACE);
+		
+		cshader = (struct md3c_shader_t*)(buf + csurf[surface].ofs_shaders);
+		for (i = 0; i < sptr->num_shaders; ++i, ++cshader) {
+			memcpy(cshader->name, sptr->shader[i].name, MAX_QPATH);
+			cshader->shader_index = sptr->shader[i].shader_index;
+		}
+		
+		/* remember what the skin resolved to */
+		cshader = (struct md3c_shader_t*)(buf + csurf[surface].ofs_shaders);
+		if (skin_file && sptr->num_shaders && textures[surface] && (strlen(textures[surface]) < MD3C_MAX_PATH))
+			strcpy(cshader->texture, textures[surface]);
+		
+		memcpy(buf + csurf[surface].ofs_indices, sptr->indices, sizeof(int) * 3 * sptr->num_triangles);
+		memcpy(buf + csurf[surface].ofs_st, sptr->st, sizeof(float) * 2 * sptr->num_verts);
+		memcpy(buf + csurf[surface].ofs_xyz, sptr->xyz, sizeof(short) * 3 * sptr->num_verts * sptr->num_frames);
+		memcpy(buf + csurf[surface].ofs_normals, sptr->normals, sizeof(unsigned short) * sptr->num_verts * sptr->num_frames);
+		memcpy(buf + csurf[surface].ofs_bounds, sptr->bounds, sizeof(struct md3_bounds_t) * sptr->num_frames);
+	}
+	memcpy(buf + layout.ofs_surfaces, csurf, sizeof(struct md3c_surface_t) * model->num_surfaces);
+	
+	/*
+	 *	Write to a temporary file first so a
+	 *	half written cook is never picked up.
+	 */
+	fptr = open_temp_file(cfile, tmp_file);
+	if (fptr) {
+		ok = (fwrite(buf, layout.file_len, 1, fptr) == 1);
+		ok = (!fclose(fptr) && ok);
+		
+		#ifdef _WIN32
+			/* rename() will not replace an existing file */
+			if (ok)
+				remove(cfile);
+		#endif
+		
+		if (!ok || rename(tmp_file, cfile))
+			remove(tmp_file);
+	}
+	
+	free(buf);
+}
+
+
+/*
+ *	Check that the MD3 file the cook was made from has not changed.
+ *
+ *	The size and modification time are checked first.  If only the
+ *	modification time differs (ie: the file was copied or checked
+ *	out again) the file content is hashed and compared.
+ */
+static int md3_cook_source_matches(char* file, struct md3c_header_t* hdr) {
+	unsigned int size = 0;
+	unsigned int mtime = 0;
+	unsigned int hash = 0;
+	byte* src = NULL;
+	long len = 0;
+	
+	if (!file_stamp(file, &size, &mtime) || (size != hdr->src_size))
+		return 0;
+	
+	if (mtime == hdr->src_mtime)
+		return 1;
+	
+	src = (byte*)map_file(file, &len);
+	if (!src)
+		return 0;
+	hash = hash_fnv1a(src, len);
+	unmap_file(src, len);
+	
+	return (hash == hdr->src_hash);
+}
+
+
+/*
+ *	Hash a .mod file, the textures resolved from
+ *	it only stay valid while it is the same.
+ *
+ *	Returns 0 if it could not be read.
+ */
+static int md3_cook_skin_hash(char* skin_file, unsigned int* hash) {
+	byte* src = NULL;
+	long len = 0;
+	
+	src = (byte*)map_file(skin_file, &len);
+	if (!src)
+		return 0;
+	*hash = hash_fnv1a(src, len);
+	unmap_file(src, len);
+	
+	return 1;
+}
+
+
+/*
+ *	Check every table in the mapped cook and return the
+ *	size of the arena needed for the parts of the model
+ *	that do not live in the cook.
+ *
+ *	Returns 0 if anything is out of bounds.
+ */
+static size_t md3_cooked_size(struct md3_model_t* header, struct md3c_header_t* hdr, byte* dptr, long len) {
+	struct md3c_surface_t* csurf = NULL;
+	struct md3c_shader_t* cshader = NULL;
+	struct md3_surface_t surf;
+	int* indices = NULL;
+	int surface = 0;
+	int i = 0;
+	int c = 0;
+	size_t size = 0;
+	
+	if ((header->ident != MD3_MAGIC_NUMBER_LITTLE_ENDIAN) ||
+		(header->num_frames <= 0) || (header->num_frames > MD3_MAX_FRAMES) ||
+		(header->num_tags < 0) || (header->num_tags > MD3_MAX_TAGS) ||
+		(header->num_surfaces < 0) || (header->num_surfaces > MD3_MAX_SURFACES) ||
+		!MD3C_IN_BOUNDS(len, hdr->ofs_frames, header->num_frames, sizeof(struct md3_frame_t)) ||
+		!MD3C_IN_BOUNDS(len, hdr->ofs_tags, (header->num_tags * header->num_frames), sizeof(struct md3_tag_t)) ||
+		!MD3C_IN_BOUNDS(len, hdr->ofs_tag_poses, (header->num_tags * header->num_frames), sizeof(struct md3_tag_pose_t)) ||
+		!MD3C_IN_BOUNDS(len, hdr->ofs_surfaces, header->num_surfaces, sizeof(struct md3c_surface_t)))
+		return 0;
+	
+	size += ARENA_SIZEOF(sizeof(struct md3_model_t));
+	size += ARENA_SIZEOF(sizeof(struct world_link_models_t));
+	size += ARENA_SIZEOF(sizeof(struct md3_model_t*) * header->num_tags);
+	size += ARENA_SIZEOF(sizeof(struct md3_surface_t) * header->num_surfaces);
+	
+	csurf = (struct md3c_surface_t*)(dptr + hdr->ofs_surfaces);
+	for (; surface < header->num_surfaces; ++surface, ++csurf) {
+		memcpy(&surf.ident, csurf->md3_surface, MD3_SIZEOF_SURFACE);
+		
+		if ((surf.num_frames <= 0) || (surf.num_frames > MD3_MAX_FRAMES) ||
+			((surf.num_verts * surf.num_frames) / surf.num_frames != surf.num_verts) ||
+			!MD3C_IN_BOUNDS(len, csurf->ofs_shaders, surf.num_shaders, sizeof(struct md3c_shader_t)) ||
+			!MD3C_IN_BOUNDS(len, csurf->ofs_indices, surf.num_triangles, (sizeof(int) * 3)) ||
+			!MD3C_IN_BOUNDS(len, csurf->ofs_st, surf.num_verts, (sizeof(float) * 2)) ||
+			!MD3C_IN_BOUNDS(len, csurf->ofs_xyz, (surf.num_verts * surf.num_frames), (sizeof(short) * 3)) ||
+			!MD3C_IN_BOUNDS(len, csurf->ofs_normals, (surf.num_verts * surf.num_frames), sizeof(unsigned short)) ||
+			!MD3C_IN_BOUNDS(len, csurf->ofs_bounds, surf.num_frames, sizeof(struct md3_bounds_t)))
+			return 0;
+		
+		/* texture names must be terminated */
+		cshader = (struct md3c_shader_t*)(dptr + csurf->ofs_shaders);
+		for (i = 0; i < surf.num_shaders; ++i, ++cshader) {
+			if (cshader->texture[MD3C_MAX_PATH - 1] != '\0')
+				return 0;
+		}
+		
+		/* every corner must reference a vertex of this surface */
+		indices = (int*)(dptr + csurf->ofs_indices);
+		for (i = 0; i < surf.num_triangles; ++i, indices += 3) {
+			for (c = 0; c < 3; ++c) {
+				if ((unsigned int)indices[c] >= (unsigned int)surf.num_verts)
+					return 0;
+			}
+		}
+		
+		size += ARENA_SIZEOF(sizeof(struct md3_shader_t) * surf.num_shaders);
+		size += ARENA_SIZEOF(sizeof(struct md3_cached_frame_t*) * surf.num_frames);
+	}
+	
+	return size;
+}
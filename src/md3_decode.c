@@ -0,0 +1,244 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	Batch vertex decoding.
+ *
+ *	MD3 vertices are stored as four shorts; x, y and z scaled
+ *	by 1/MD3_XYZ_SCALE and a lat/lng encoded normal, which the
+ *	loader splits into separate coordinate and normal arrays.
+ *	A frame of a surface is decoded here in one pass into
+ *	pre-scaled float positions and unit normals so nothing
+ *	has to be scaled or decoded while rendering.
+ *
+ *	Two frames are interpolated here too, every vertex of a
+ *	surface at once.  Nothing here touches OpenGL.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "definitions.h"
+#include "md3_parse.h"
+#include "md3_decode.h"
+
+#ifdef USE_SSE2
+	#include <emmintrin.h>
+#endif
+#ifdef USE_AVX2
+	#include <immintrin.h>
+#endif
+
+
+/* decoded normal for every encoded normal */
+float md3_normal_table[MD3_NORMAL_TABLE_SIZE][3];
+
+static int normal_table_built = 0;
+
+static void md3_lerp_floats(const float* a, const float* b, int n, float t, float* dst);
+
+
+/*
+ *	Build the normal lookup table.
+ *	Safe to call more than once.
+ *
+ *	The decode is modified from the Quake3 source code base.
+ *	File: code/q3map/misc_model.c:InsertMD3Model()
+ */
+void md3_decode_init() {
+	float lat_cos[256], lat_sin[256];
+	float lng_cos[256], lng_sin[256];
+	int lat, lng;
+	float* n;
+
+	if (normal_table_built)
+		return;
+
+	for (lat = 0; lat < 256; ++lat) {
+		lat_cos[lat] = (float)cos(lat * (PI / 128));
+		lat_sin[lat] = (float)sin(lat * (PI / 128));
+	}
+	for (lng = 0; lng < 256; ++lng) {
+		lng_cos[lng] = (float)cos(lng * (PI / 128));
+		lng_sin[lng] = (float)sin(lng * (PI / 128));
+	}
+
+	for (lat = 0; lat < 256; ++lat) {
+		for (lng = 0; lng < 256; ++lng) {
+			n = md3_normal_table[(lat << 8) | lng];
+			n[0] = (lat_cos[lat] * lng_sin[lng]);
+			n[1] = (lat_sin[lat] * lng_sin[lng]);
+			n[2] = lng_cos[lng];
+		}
+	}
+
+	normal_table_built = 1;
+}
+
+
+/*
+ *	Decode count verticies; 3 quantized coordinates each at xyz
+ *	and an encoded normal each at normals, into 3 floats each
+ *	at dst_xyz and dst_normals.
+ *
+ *	Optimization.
+ *
+ *	The coordinates are one flat array of shorts so they are
+ *	converted and scaled 8 at a time without caring where one
+ *	vertex ends and the next begins.  No alignment is required.
+ */
+void md3_decode_vertices(const short* xyz, const unsigned short* normals, int count, float* dst_xyz, float* dst_normals) {
+	int n = (count * 3);
+	int i = 0;
+
+	#if defined(USE_AVX2)
+		const __m256 scale8 = _mm256_set1_ps(MD3_XYZ_SCALE);
+
+		for (; (i + 8) <= n; i += 8)
+			_mm256_storeu_ps((dst_xyz + i), _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(xyz + i)))), scale8));
+	#elif defined(USE_SSE2)
+		const __m128 scale4 = _mm_set1_ps(MD3_XYZ_SCALE);
+		__m128i packed;
+
+		for (; (i + 8) <= n; i += 8) {
+			/* sign extend the shorts by unpacking into the high half and shifting down */
+			packed = _mm_loadu_si128((const __m128i*)(xyz + i));
+			_mm_storeu_ps((dst_xyz + i), _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16)), scale4));
+			_mm_storeu_ps((dst_xyz + i + 4), _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16)), scale4));
+		}
+	#endif
+
+	/* whatever is left over */
+	for (; i < n; ++i)
+		dst_xyz[i] = (xyz[i] * MD3_XYZ_SCALE);
+
+	for (i = 0; i < count; ++i)
+		memcpy((dst_normals + (i * 3)), MD3_DECODE_NORMAL(normals[i]), (sizeof(float) * 3));
+}
+
+
+/*
+ *	Interpolate count verticies between two decoded frames by t;
+ *	3 floats each at xyz1/xyz2 and normals1/normals2, into 3 floats
+ *	each at dst_xyz and dst_normals.
+ *
+ *	Every vertex is interpolated once, however many triangles
+ *	share it.  The normals are not normalized again.
+ */
+void md3_lerp_vertices(const float* xyz1, const float* normals1, const float* xyz2, const float* normals2, int count, float t, float* dst_xyz, float* dst_normals) {
+	md3_lerp_floats(xyz1, xyz2, (count * 3), t, dst_xyz);
+	md3_lerp_floats(normals1, normals2, (count * 3), t, dst_normals);
+}
+
+
+/*
+ *	md3_lerp_vertices() for verticies still quantized as they are
+ *	in the MD3 file, dequantizing and decoding them as it goes.
+ *
+ *	Optimization.
+ *
+ *	As in md3_decode_vertices(), the coordinates are done 8 at a
+ *	time as one flat array.  The normals have to be looked up one
+ *	at a time.
+ */
+void md3_lerp_quantized(const short* xyz1, const unsigned short* normals1, const short* xyz2, const unsigned short* normals2, int count, float t, float* dst_xyz, float* dst_normals) {
+	const float* n1 = NULL;
+	const float* n2 = NULL;
+	int n = (count * 3);
+	int i = 0;
+
+	#if defined(USE_AVX2)
+		const __m256 t8 = _mm256_set1_ps(t);
+		const __m256 scale8 = _mm256_set1_ps(MD3_XYZ_SCALE);
+		__m256i a;
+		__m256i b;
+
+		for (; (i + 8) <= n; i += 8) {
+			a = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(xyz1 + i)));
+			b = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(xyz2 + i)));
+			_mm256_storeu_ps((dst_xyz + i), _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(a), _mm256_mul_ps(t8, _mm256_cvtepi32_ps(_mm256_sub_epi32(b, a)))), scale8));
+		}
+	#elif defined(USE_SSE2)
+		const __m128 t4 = _mm_set1_ps(t);
+		const __m128 scale4 = _mm_set1_ps(MD3_XYZ_SCALE);
+		__m128i packed1;
+		__m128i packed2;
+		__m128i a;
+		__m128i b;
+
+		for (; (i + 8) <= n; i += 8) {
+			packed1 = _mm_loadu_si128((const __m128i*)(xyz1 + i));
+			packed2 = _mm_loadu_si128((const __m128i*)(xyz2 + i));
+			
+			a = _mm_srai_epi32(_mm_unpacklo_epi16(packed1, packed1), 16);
+			b = _mm_srai_epi32(_mm_unpacklo_epi16(packed2, packed2), 16);
+			_mm_storeu_ps((dst_xyz + i), _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(a), _mm_mul_ps(t4, _mm_cvtepi32_ps(_mm_sub_epi32(b, a)))), scale4));
+			
+			a = _mm_srai_epi32(_mm_unpackhi_epi16(packed1, packed1), 16);
+			b = _mm_srai_epi32(_mm_unpackhi_epi16(packed2, packed2), 16);
+			_mm_storeu_ps((dst_xyz + i + 4), _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(a), _mm_mul_ps(t4, _mm_cvtepi32_ps(_mm_sub_epi32(b, a)))), scale4));
+		}
+	#endif
+
+	/* whatever is left over */
+	for (; i < n; ++i)
+		dst_xyz[i] = ((xyz1[i] + (t * (xyz2[i] - xyz1[i]))) * MD3_XYZ_SCALE);
+
+	for (i = 0; i < count; ++i, dst_normals += 3) {
+		n1 = MD3_DECODE_NORMAL(normals1[i]);
+		n2 = MD3_DECODE_NORMAL(normals2[i]);
+		dst_normals[0] = (n1[0] + (t * (n2[0] - n1[0])));
+		dst_normals[1] = (n1[1] + (t * (n2[1] - n1[1])));
+		dst_normals[2] = (n1[2] + (t * (n2[2] - n1[2])));
+	}
+}
+
+
+/*
+ *	dst = a + (t * (b - a)) for n floats.
+ *
+ *	Optimization.
+ *
+ *	8 (AVX2) or 4 (SSE2) floats at a time.  The frame cache hands
+ *	out 16 byte aligned frames but nothing here requires it.
+ */
+static void md3_lerp_floats(const float* a, const float* b, int n, float t, float* dst) {
+	int i = 0;
+
+	#if defined(USE_AVX2)
+		const __m256 t8 = _mm256_set1_ps(t);
+		__m256 a8;
+
+		for (; (i + 8) <= n; i += 8) {
+			a8 = _mm256_loadu_ps(a + i);
+			_mm256_storeu_ps((dst + i), _mm256_add_ps(a8, _mm256_mul_ps(t8, _mm256_sub_ps(_mm256_loadu_ps(b + i), a8))));
+		}
+	#elif defined(USE_SSE2)
+		const __m128 t4 = _mm_set1_ps(t);
+		__m128 a4;
+
+		for (; (i + 4) <= n; i += 4) {
+			a4 = _mm_loadu_ps(a + i);
+			_mm_storeu_ps((dst + i), _mm_add_ps(a4, _mm_mul_ps(t4, _mm_sub_ps(_mm_loadu_ps(b + i), a4))));
+		}
+	#endif
+
+	/* whatever is left over */
+	for (; i < n; ++i)
+		dst[i] = (a[i] + (t * (b[i] - a[i])));
+}
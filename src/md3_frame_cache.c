@@ -0,0 +1,275 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	Frame cache.
+ *
+ *	Optimization.
+ *
+ *	Decoding turns every 8 byte MD3 vertex into 24 bytes of
+ *	floats, but at any time only the frames of the animations
+ *	being played are drawn.  So the verticies stay encoded and
+ *	frames are decoded when they are first needed, keeping only
+ *	the most recently used ones around.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "definitions.h"
+#include "md3_parse.h"
+#include "md3_decode.h"
+#include "md3_frame_cache.h"
+
+
+/* the decoded arrays start 16 byte aligned */
+#define FRAME_ALIGN(_x)		(((_x) + 15) & ~((size_t)15))
+
+/* bytes needed to cache a frame of a surface */
+#define FRAME_SIZE(_sptr)	(FRAME_ALIGN(sizeof(struct md3_cached_frame_t)) + (FRAME_ALIGN(sizeof(float) * 3 * (_sptr)->num_verts) * 2) + 15)
+
+
+/* every cached frame from most to least recently used */
+static struct md3_cached_frame_t* lru_head = NULL;
+static struct md3_cached_frame_t* lru_tail = NULL;
+
+static size_t cache_used = 0;
+static size_t cache_budget = MD3_FRAME_CACHE_BUDGET;
+static size_t cache_cycles = 0;		/* bytes the animations being played need */
+
+
+static void lru_unlink(struct md3_cached_frame_t* cf);
+static void lru_push(struct md3_cached_frame_t* cf);
+static void drop_frame(struct md3_cached_frame_t* cf);
+static void trim_cache();
+static size_t cache_limit();
+
+
+/*
+ *	Return a decoded frame of a surface, decoding
+ *	the frame if it is not in the cache.
+ *
+ *	The frame stays valid until the frame is dropped from
+ *	the cache.  The two most recently used frames are never
+ *	dropped, so both frames a surface is interpolated between
+ *	can be used at the same time.
+ *
+ *	Returns NULL if the frame does not exist or is out of memory.
+ */
+struct md3_cached_frame_t* md3_surface_frame(struct md3_surface_t* sptr, int frame) {
+	struct md3_cached_frame_t* cf = NULL;
+	size_t size = FRAME_SIZE(sptr);
+	
+	if ((frame < 0) || (frame >= sptr->num_frames) || !sptr->cached_frames)
+		return NULL;
+	
+	cf = sptr->cached_frames[frame];
+	if (cf) {
+		/* move it to the front */
+		if (cf != lru_head) {
+			lru_unlink(cf);
+			lru_push(cf);
+		}
+		return cf;
+	}
+	
+	/* the arrays are kept right after the frame structure */
+	cf = (struct md3_cached_frame_t*)malloc(size);
+	if (!cf)
+		return NULL;
+	
+	cf->surface = sptr;
+	cf->frame = frame;
+	cf->size = size;
+	cf->xyz = (float*)FRAME_ALIGN((size_t)(cf + 1));
+	cf->normals = (float*)((byte*)cf->xyz + FRAME_ALIGN(sizeof(float) * 3 * sptr->num_verts));
+	md3_decode_vertices((sptr->xyz + (frame * sptr->num_verts * 3)), (sptr->normals + (frame * sptr->num_verts)), sptr->num_verts, cf->xyz, cf->normals);
+	
+	sptr->cached_frames[frame] = cf;
+	lru_push(cf);
+	cache_used += size;
+	
+	trim_cache();
+	
+	return cf;
+}
+
+
+/*
+ *	Decode the frames first_frame to last_frame of every
+ *	surface of a model ahead of time.
+ *	Called when an animation is selected.
+ *
+ *	The cache is grown to hold the whole animation (see
+ *	cache_limit()).  If it still does not fit only as many
+ *	frames as fit are decoded.  They are decoded last to first
+ *	so the frames played first are the last to be dropped.
+ */
+void md3_frame_cache_prefetch(struct md3_model_t* model, int first_frame, int last_frame) {
+	struct md3_surface_t* sptr = NULL;
+	size_t need = 0;
+	size_t frame_size = 0;
+	int frame = 0;
+	int surface = 0;
+	
+	#ifdef USE_QUANTIZED_VERTICES
+		/* the renderer does not use the cache */
+		return;
+	#endif
+	
+	if (!model)
+		return;
+	
+	if (first_frame < 0)
+		first_frame = 0;
+	if (last_frame >= model->num_frames)
+		last_frame = (model->num_frames - 1);
+	if (last_frame < first_frame)
+		return;
+	
+	/* how much does one frame of every surface take, and the whole animation */
+	for (surface = 0; surface < model->num_surfaces; ++surface) {
+		sptr = &model->surfaces[surface];
+		frame_size += FRAME_SIZE(sptr);
+		
+		cache_cycles -= sptr->cached_cycle;
+		sptr->cached_cycle = (FRAME_SIZE(sptr) * (last_frame - first_frame + 1));
+		cache_cycles += sptr->cached_cycle;
+	}
+	
+	for (frame = first_frame; frame <= last_frame; ++frame) {
+		need += frame_size;
+		if (need > cache_limit()) {
+			last_frame = (frame - 1);
+			break;
+		}
+	}
+	
+	for (frame = last_frame; frame >= first_frame; --frame) {
+		for (surface = 0; surface < model->num_surfaces; ++surface) {
+			sptr = &model->surfaces[surface];
+			md3_surface_frame(sptr, (frame % sptr->num_frames));
+		}
+	}
+}
+
+
+/*
+ *	Drop every cached frame of a surface.
+ *	Must be called before the surface is freed.
+ */
+void md3_frame_cache_drop(struct md3_surface_t* sptr) {
+	int frame = 0;
+	
+	cache_cycles -= sptr->cached_cycle;
+	sptr->cached_cycle = 0;
+	
+	if (!sptr->cached_frames)
+		return;
+	
+	for (; frame < sptr->num_frames; ++frame) {
+		if (sptr->cached_frames[frame])
+			drop_frame(sptr->cached_frames[frame]);
+	}
+}
+
+
+/*
+ *	Set how many bytes the cache may use
+ *	when no animations are being played.
+ */
+void md3_frame_cache_set_budget(size_t budget) {
+	cache_budget = budget;
+	trim_cache();
+}
+
+
+/*
+ *	How many bytes the cache may use right now.
+ */
+size_t md3_frame_cache_budget() {
+	return cache_limit();
+}
+
+
+/*
+ *	How many bytes the cached frames are using.
+ */
+size_t md3_frame_cache_used() {
+	return cache_used;
+}
+
+
+static void lru_unlink(struct md3_cached_frame_t* cf) {
+	if (cf->prev)
+		cf->prev->next = cf->next;
+	else
+		lru_head = cf->next;
+	
+	if (cf->next)
+		cf->next->prev = cf->prev;
+	else
+		lru_tail = cf->prev;
+	
+	cf->prev = cf->next = NULL;
+}
+
+
+static void lru_push(struct md3_cached_frame_t* cf) {
+	cf->prev = NULL;
+	cf->next = lru_head;
+	
+	if (lru_head)
+		lru_head->prev = cf;
+	else
+		lru_tail = cf;
+	
+	lru_head = cf;
+}
+
+
+static void drop_frame(struct md3_cached_frame_t* cf) {
+	lru_unlink(cf);
+	cf->surface->cached_frames[cf->frame] = NULL;
+	cache_used -= cf->size;
+	free(cf);
+}
+
+
+/*
+ *	Drop the least recently used frames until the
+ *	cache is within its budget, keeping the two most
+ *	recently used frames.
+ */
+static void trim_cache() {
+	while ((cache_used > cache_limit()) && lru_tail && (lru_tail != lru_head) && (lru_tail != lru_head->next))
+		drop_frame(lru_tail);
+}
+
+
+/*
+ *	The budget, grown to fit every frame of the animations
+ *	being played but no larger than MD3_FRAME_CACHE_MAX_BUDGET.
+ */
+static size_t cache_limit() {
+	if (cache_cycles <= cache_budget)
+		return cache_budget;
+	if (cache_cycles >= MD3_FRAME_CACHE_MAX_BUDGET)
+		return ((cache_budget > MD3_FRAME_CACHE_MAX_BUDGET) ? cache_budget : MD3_FRAME_CACHE_MAX_BUDGET);
+	return cache_cycles;
+}
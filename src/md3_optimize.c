@@ -0,0 +1,336 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	Vertex cache optimization.
+ *
+ *	See md3_optimize.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "definitions.h"
+#include "md3_parse.h"
+#include "md3_optimize.h"
+
+/*
+ *	A vertex while the triangles are being ordered.
+ */
+struct md3_opt_vertex_t {
+	int cache_pos;			/* position in the LRU cache (-1 = not in it)	*/
+	int remaining;			/* triangles using it not yet ordered			*/
+	int first;				/* those triangles, in md3_opt_t.tris			*/
+	float score;
+};
+
+struct md3_opt_t {
+	struct md3_opt_vertex_t* verts;
+	int* tris;				/* triangles using each vertex, remaining ones first	*/
+	float* tri_scores;
+	byte* tri_added;
+	int cache[MD3_OPTIMIZE_CACHE_SIZE + 3];
+	int cache_len;
+};
+
+static void md3_order_triangles(struct md3_opt_t* opt, const int* indices, int num_triangles, int* order);
+static void md3_add_triangle(struct md3_opt_t* opt, const int* indices, int tri);
+static float md3_vertex_score(struct md3_opt_vertex_t* v);
+static int md3_reorder_vertices(struct md3_surface_t* sptr);
+
+
+/*
+ *	Reorder the triangles, then the verticies, of a surface
+ *	for the vertex caches.
+ *
+ *	Returns 0 if the surface was left as it was (out of
+ *	memory or bad indices).
+ */
+int md3_optimize_surface(struct md3_surface_t* sptr) {
+	struct md3_opt_t opt;
+	int* order = NULL;
+	int* next = NULL;
+	int i = 0;
+	
+	if (sptr->num_triangles < 2)
+		return 1;
+	
+	for (; i < (sptr->num_triangles * 3); ++i) {
+		if ((sptr->indices[i] < 0) || (sptr->indices[i] >= sptr->num_verts))
+			return 0;
+	}
+	
+	memset(&opt, 0, sizeof(struct md3_opt_t));
+	opt.verts = (struct md3_opt_vertex_t*)malloc(sizeof(struct md3_opt_vertex_t) * sptr->num_verts);
+	opt.tris = (int*)malloc(sizeof(int) * sptr->num_triangles * 3);
+	opt.tri_scores = (float*)malloc(sizeof(float) * sptr->num_triangles);
+	opt.tri_added = (byte*)malloc(sptr->num_triangles);
+	order = (int*)malloc(sizeof(int) * sptr->num_triangles * 3);
+	next = (int*)malloc(sizeof(int) * sptr->num_verts);
+	
+	if (opt.verts && opt.tris && opt.tri_scores && opt.tri_added && order && next) {
+		/* the triangles using each vertex */
+		memset(opt.verts, 0, sizeof(struct md3_opt_vertex_t) * sptr->num_verts);
+		for (i = 0; i < (sptr->num_triangles * 3); ++i)
+			++opt.verts[sptr->indices[i]].remaining;
+		for (i = 0; i < sptr->num_verts; ++i) {
+			opt.verts[i].cache_pos = -1;
+			opt.verts[i].first = (i ? (opt.verts[i - 1].first + opt.verts[i - 1].remaining) : 0);
+			next[i] = opt.verts[i].first;
+		}
+		for (i = 0; i < (sptr->num_triangles * 3); ++i)
+			opt.tris[next[sptr->indices[i]]++] = (i / 3);
+		
+		md3_order_triangles(&opt, sptr->indices, sptr->num_triangles, order);
+		memcpy(sptr->indices, order, (sizeof(int) * sptr->num_triangles * 3));
+	}
+	
+	free(opt.verts);
+	free(opt.tris);
+	free(opt.tri_scores);
+	free(opt.tri_added);
+	free(next);
+	
+	if (!order)
+		return 0;
+	free(order);
+	
+	return md3_reorder_vertices(sptr);
+}
+
+
+/*
+ *	The average cache miss ratio of a triangle list; verticies
+ *	transformed per triangle drawn through a FIFO cache of
+ *	MD3_ACMR_CACHE_SIZE verticies.
+ *
+ *	Returns 0 if out of memory.
+ */
+float md3_acmr(const int* indices, int num_triangles, int num_verts) {
+	int* stamps = NULL;
+	int misses = 0;
+	int i = 0;
+	
+	if (!num_triangles)
+		return 0;
+	
+	/* the miss count each vertex was cached at, it is still cached for the next MD3_ACMR_CACHE_SIZE misses */
+	stamps = (int*)malloc(sizeof(int) * num_verts);
+	if (!stamps)
+		return 0;
+	for (; i < num_verts; ++i)
+		stamps[i] = -MD3_ACMR_CACHE_SIZE;
+	
+	for (i = 0; i < (num_triangles * 3); ++i) {
+		if ((misses - stamps[indices[i]]) >= MD3_ACMR_CACHE_SIZE)
+			stamps[indices[i]] = misses++;
+	}
+	
+	free(stamps);
+	return ((float)misses / num_triangles);
+}
+
+
+/*
+ *	Order the triangles, greedily taking the best scoring
+ *	triangle that uses a vertex in the cache each time.
+ */
+static void md3_order_triangles(struct md3_opt_t* opt, const int* indices, int num_triangles, int* order) {
+	struct md3_opt_vertex_t* v = NULL;
+	int best = -1;
+	int tri = 0;
+	int i = 0;
+	int j = 0;
+	
+	for (i = 0; i < (num_triangles * 3); ++i)
+		opt->verts[indices[i]].score = md3_vertex_score(&opt->verts[indices[i]]);
+	
+	memset(opt->tri_added, 0, num_triangles);
+	for (tri = 0; tri < num_triangles; ++tri) {
+		opt->tri_scores[tri] = (opt->verts[indices[tri * 3]].score + opt->verts[indices[(tri * 3) + 1]].score + opt->verts[indices[(tri * 3) + 2]].score);
+		if ((best == -1) || (opt->tri_scores[tri] > opt->tri_scores[best]))
+			best = tri;
+	}
+	
+	for (tri = 0; tri < num_triangles; ++tri) {
+		/* nothing in the cache is used by what is left, start again from the best of the rest */
+		if (best == -1) {
+			for (i = 0; i < num_triangles; ++i) {
+				if (!opt->tri_added[i] && ((best == -1) || (opt->tri_scores[i] > opt->tri_scores[best])))
+					best = i;
+			}
+		}
+		
+		memcpy((order + (tri * 3)), (indices + (best * 3)), (sizeof(int) * 3));
+		md3_add_triangle(opt, indices, best);
+		
+		/* the next one is the best triangle using a vertex in the cache */
+		best = -1;
+		for (i = 0; i < opt->cache_len; ++i) {
+			v = &opt->verts[opt->cache[i]];
+			for (j = v->first; j < (v->first + v->remaining); ++j) {
+				if ((best == -1) || (opt->tri_scores[opt->tris[j]] > opt->tri_scores[best]))
+					best = opt->tris[j];
+			}
+		}
+	}
+}
+
+
+/*
+ *	Take a triangle out of the ones left to order and put its
+ *	verticies at the front of the cache, rescoring every vertex
+ *	in the cache and the triangles they are used by.
+ */
+static void md3_add_triangle(struct md3_opt_t* opt, const int* indices, int tri) {
+	struct md3_opt_vertex_t* v = NULL;
+	int cache[MD3_OPTIMIZE_CACHE_SIZE + 3];
+	int cache_len = 0;
+	int i = 0;
+	int j = 0;
+	
+	opt->tri_added[tri] = 1;
+	
+	for (; i < 3; ++i) {
+		v = &opt->verts[indices[(tri * 3) + i]];
+		
+		/* swap it past the remaining triangles of the vertex */
+		for (j = v->first; opt->tris[j] != tri; ++j)
+			;
+		opt->tris[j] = opt->tris[v->first + v->remaining - 1];
+		opt->tris[v->first + v->remaining - 1] = tri;
+		--v->remaining;
+		
+		/* degenerate triangles use a vertex twice */
+		for (j = 0; (j < cache_len) && (cache[j] != indices[(tri * 3) + i]); ++j)
+			;
+		if (j == cache_len)
+			cache[cache_len++] = indices[(tri * 3) + i];
+	}
+	
+	/* the rest of the cache moves back, the last ones fall out */
+	for (i = 0; i < opt->cache_len; ++i) {
+		for (j = 0; (j < 3) && (j < cache_len) && (opt->cache[i] != cache[j]); ++j)
+			;
+		if ((j == 3) || (j == cache_len))
+			cache[cache_len++] = opt->cache[i];
+	}
+	
+	for (i = 0; i < cache_len; ++i) {
+		v = &opt->verts[cache[i]];
+		v->cache_pos = ((i < MD3_OPTIMIZE_CACHE_SIZE) ? i : -1);
+		v->score = md3_vertex_score(v);
+	}
+	for (i = 0; i < cache_len; ++i) {
+		v = &opt->verts[cache[i]];
+		for (j = v->first; j < (v->first + v->remaining); ++j) {
+			tri = opt->tris[j];
+			opt->tri_scores[tri] = (opt->verts[indices[tri * 3]].score + opt->verts[indices[(tri * 3) + 1]].score + opt->verts[indices[(tri * 3) + 2]].score);
+		}
+	}
+	
+	opt->cache_len = ((cache_len < MD3_OPTIMIZE_CACHE_SIZE) ? cache_len : MD3_OPTIMIZE_CACHE_SIZE);
+	memcpy(opt->cache, cache, (sizeof(int) * opt->cache_len));
+}
+
+
+/*
+ *	Score a vertex by where it is in the cache and how many
+ *	triangles still use it, so lone verticies get finished off
+ *	rather than left behind.  Constants are Forsyth's.
+ */
+static float md3_vertex_score(struct md3_opt_vertex_t* v) {
+	float score = 0;
+	
+	if (!v->remaining)
+		return -1.0f;
+	
+	if (v->cache_pos >= 0) {
+		/*
+		 *	The last triangle's verticies get a fixed score so
+		 *	it does not just follow a strip.
+		 */
+		if (v->cache_pos < 3)
+			score = 0.75f;
+		else
+			score = (float)pow((1.0f - ((v->cache_pos - 3) * (1.0f / (MD3_OPTIMIZE_CACHE_SIZE - 3)))), 1.5f);
+	}
+	
+	return (score + (2.0f * (float)pow((float)v->remaining, -0.5f)));
+}
+
+
+/*
+ *	Renumber the verticies of a surface in the order its triangles
+ *	first use them, moving texture coordinates, and the coordinates
+ *	and normals of every frame, along with them.
+ *
+ *	Returns 0 if out of memory.
+ */
+static int md3_reorder_vertices(struct md3_surface_t* sptr) {
+	int* remap = NULL;
+	byte* old = NULL;
+	short* fxyz = NULL;
+	unsigned short* fnormals = NULL;
+	int n = 0;
+	int i = 0;
+	int frame = 0;
+	
+	/* room for the biggest per vertex array (the texture coordinates) */
+	remap = (int*)malloc(sizeof(int) * sptr->num_verts);
+	old = (byte*)malloc(sizeof(float) * 2 * sptr->num_verts);
+	if (!remap || !old) {
+		free(remap);
+		free(old);
+		return 0;
+	}
+	
+	/* new index of each vertex (unused ones go last) */
+	for (i = 0; i < sptr->num_verts; ++i)
+		remap[i] = -1;
+	for (i = 0; i < (sptr->num_triangles * 3); ++i) {
+		if (remap[sptr->indices[i]] == -1)
+			remap[sptr->indices[i]] = n++;
+		sptr->indices[i] = remap[sptr->indices[i]];
+	}
+	for (i = 0; i < sptr->num_verts; ++i) {
+		if (remap[i] == -1)
+			remap[i] = n++;
+	}
+	
+	memcpy(old, sptr->st, (sizeof(float) * 2 * sptr->num_verts));
+	for (i = 0; i < sptr->num_verts; ++i)
+		memcpy((sptr->st + (remap[i] * 2)), (old + (sizeof(float) * 2 * i)), (sizeof(float) * 2));
+	
+	for (; frame < sptr->num_frames; ++frame) {
+		fxyz = (sptr->xyz + (frame * sptr->num_verts * 3));
+		memcpy(old, fxyz, (sizeof(short) * 3 * sptr->num_verts));
+		for (i = 0; i < sptr->num_verts; ++i)
+			memcpy((fxyz + (remap[i] * 3)), (old + (sizeof(short) * 3 * i)), (sizeof(short) * 3));
+		
+		fnormals = (sptr->normals + (frame * sptr->num_verts));
+		memcpy(old, fnormals, (sizeof(unsigned short) * sptr->num_verts));
+		for (i = 0; i < sptr->num_verts; ++i)
+			fnormals[remap[i]] = ((unsigned short*)old)[i];
+	}
+	
+	free(remap);
+	free(old);
+	return 1;
+}
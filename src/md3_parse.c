@@ -21,12 +21,20 @@
 #include <malloc.h>
 #include <math.h>
 #include <stdarg.h>
+#include <limits.h>
 
 #include "definitions.h"
 #include "util.h"
 #include "tga.h"
 #include "world.h"
 #include "md3_parse.h"
+#include "md3_frame_cache.h"
+#include "md3_vbo.h"
+#include "md3_optimize.h"
+#include "md3_cook.h"
+#include "atlas.h"
+#include "arena.h"
+#include "quaternion.h"
 
 /*
  *	Valid animations.
@@ -61,10 +69,29 @@ static struct md3_anim_names_t anim_structs[] = {
 };
 
 
-static void md3_load_surfaces(struct md3_model_t* model, char* texture_path_prefix);
-static void md3_make_normal(struct md3_vertex_t* vertex);
+static struct md3_model_t* md3_read_model(char* file, char* skin_file, int cook);
+static struct md3_model_t* md3_parse_model(char* file);
+static size_t md3_model_size(struct md3_model_t* header);
+static int md3_surface_in_bounds(struct md3_model_t* header, long surface_start, int offset, int elements, size_t size);
+static void md3_load_surfaces(struct md3_model_t* model);
+static void md3_build_tag_poses(struct md3_model_t* model);
+static void md3_split_vertices(byte* src, int count, short* xyz, unsigned short* normals);
+static void md3_build_bounds(struct md3_surface_t* sptr);
+static void md3_free_model(struct md3_model_t* model);
 
-static void load_texture_for_model(struct md3_model_t* model, char* texture, char* surface);
+static void md3_load_prefix_textures(struct md3_model_t* model, char* texture_path_prefix, struct md3_plan_part_t* part);
+static void md3_load_cooked_textures(struct md3_model_t* model, struct md3_load_plan_t* plan);
+static struct tga_t** md3_plan_texture(struct md3_load_plan_t* plan, struct md3_plan_part_t* part, char* file);
+static void md3_plan_part_job(void* arg);
+static void md3_plan_texture_job(void* arg);
+static void md3_plan_anim_job(void* arg);
+static int md3_plan_queue_second_round(struct md3_load_plan_t* plan);
+static char* md3_plan_surface_texture(struct md3_load_plan_t* plan, struct md3_plan_part_t* part, int surface);
+#ifdef USE_TEXTURE_ATLAS
+	static void md3_plan_atlas_job(void* arg);
+#endif
+
+static void load_texture_for_model(struct md3_model_t* model, char* texture, char* surface, struct tga_t** decoded);
 static int load_anim_file(char* file, struct md3_anim_t* aptr);
 
 
@@ -76,55 +103,161 @@ static int load_anim_file(char* file, struct md3_anim_t* aptr);
  *	and not the skin stuff.  Otherwise pass NULL.
  */
 struct md3_model_t* md3_load_model(char* file, char* texture_path_prefix) {
-	struct md3_model_t* model = (struct md3_model_t*)malloc(sizeof(struct md3_model_t));
+	struct md3_model_t* model = md3_read_model(file, NULL, (texture_path_prefix != NULL));
+	if (!model)
+		return NULL;
+	
+	if (texture_path_prefix)
+		md3_load_prefix_textures(model, texture_path_prefix, NULL);
+	
+	return model;
+}
+
+
+/*
+ *	Read an MD3 model without loading any textures.
+ *	Nothing in the world is touched so this may run on any thread.
+ *
+ *	skin_file is the .mod file the skin comes from (NULL if none).
+ *	If cook is set the model is cooked when it had to be parsed.
+ *
+ *	Optimization.
+ *
+ *	If the model has been cooked (see md3_cook.h) and the cook is
+ *	up to date, the model is used straight out of the cook and
+ *	nothing has to be decoded.
+ *	If the cook was made with the same skin the textures are already
+ *	resolved and model->skinned is set.
+ */
+static struct md3_model_t* md3_read_model(char* file, char* skin_file, int cook) {
+	struct md3_model_t* model = NULL;
+	
+	model = md3_load_cooked(file, skin_file);
+	if (!model) {
+		model = md3_parse_model(file);
+		if (!model)
+			return NULL;
+		
+		if (cook)
+			md3_cook_model(model, file, NULL, NULL);
+	}
+	
+	/* initialize the animation state */
+	model->anim_state.anim_info = NULL;
+	model->anim_state.id = 0;
+	model->anim_state.frame = 0;
+	model->anim_state.next_frame = 0;
+	model->anim_state.t = 0;
+	model->anim_state.last_time = 0.0;
+	model->anim_state.animated = 0;
+	
+	/* initialize custom rotation */
+	model->rot[0] = 0.0f;
+	model->rot[1] = 0.0f;
+	model->rot[2] = 0.0f;
+	model->scale_factor = 1.0f;
+	
+	return model;
+}
+
+
+/*
+ *	Parse an MD3 model file.
+ *	Returns a pointer to the MD3 model structure, NULL on failure.
+ */
+static struct md3_model_t* md3_parse_model(char* file) {
+	struct md3_model_t header;
+	struct md3_model_t* model = NULL;
+	struct arena_t* arena = NULL;
+	size_t size = 0;
 
 	#ifdef MD3_DEBUG
 	int i = 0;
 	#endif
 
-	memset(model, 0, sizeof(struct md3_model_t));
+	memset(&header, 0, sizeof(struct md3_model_t));
 	
 	/*
 	 *	Open model file and map it into memory.
+	 *
+	 *	Optimization.
+	 *
+	 *	Everything is parsed directly out of the mapped file
+	 *	rather than seeking and reading each structure
+	 *	(and every single vertex) from disk.
 	 */
-	model->fptr = fopen(file, "rb");
-	if (!model->fptr) {
+	header.dptr = (byte*)map_file(file, &header.file_len);
+	if (!header.dptr) {
 		printf("ERROR: Failed to open model file \"%s\".\n", file);
-		free(model);
 		return NULL;
 	}
 	
-	/* get length of file */
-	fseek(model->fptr, 0, SEEK_END);
-	model->file_len = ftell(model->fptr);
-	fseek(model->fptr, 0, SEEK_SET);
-	
 	#ifdef MD3_DEBUG
-	printf("File Length: %ld bytes\n", model->file_len);
+	printf("File Length: %ld bytes\n", header.file_len);
 	#endif
 	
-	fread(&model->ident, MD3_SIZEOF_HEADER, 1, model->fptr);
+	if (header.file_len < (long)MD3_SIZEOF_HEADER) {
+		printf("ERROR: Model file \"%s\" is too small to be an MD3.\n", file);
+		unmap_file(header.dptr, header.file_len);
+		return NULL;
+	}
+	memcpy(&header.ident, header.dptr, MD3_SIZEOF_HEADER);
 	
 	#ifdef MD3_DEBUG
-	printf("magic number: %i (%s)\n", model->ident, (model->ident == 0x33504449) ? "little endian" : "big endian");
-	printf("md3 version: %i\n", model->version);
-	printf("name: \"%s\"\n", model->name);
-	printf("flags: %i\n", model->flags);
-	printf("frames: %i\n", model->num_frames);
-	printf("tags: %i\n", model->num_tags);
-	printf("surfaces: %i\n", model->num_surfaces);
-	printf("tags: %i\n", model->num_tags);
-	printf("surfaces: %i\n", model->num_surfaces);
-	printf("skins: %i\n", model->num_skins);
-	printf("frames offset: %i\n", model->ofs_frames);
-	printf("tags offsets: %i\n", model->ofs_tags);
-	printf("surfaces offsets: %i\n", model->ofs_surfaces);
-	printf("EOF offset: %i\n", model->ofs_eof);
+	printf("magic number: %i (%s)\n", header.ident, (header.ident == 0x33504449) ? "little endian" : "big endian");
+	printf("md3 version: %i\n", header.version);
+	printf("name: \"%s\"\n", header.name);
+	printf("flags: %i\n", header.flags);
+	printf("frames: %i\n", header.num_frames);
+	printf("tags: %i\n", header.num_tags);
+	printf("surfaces: %i\n", header.num_surfaces);
+	printf("skins: %i\n", header.num_skins);
+	printf("frames offset: %i\n", header.ofs_frames);
+	printf("tags offsets: %i\n", header.ofs_tags);
+	printf("surfaces offsets: %i\n", header.ofs_surfaces);
+	printf("EOF offset: %i\n", header.ofs_eof);
 	printf("\n\n");
 	#endif
 	
+	/*
+	 *	Everything in the file must be located before ofs_eof,
+	 *	which in turn must be within the file.
+	 *
+	 *	Optimization.
+	 *
+	 *	While checking the surfaces add up how much memory the
+	 *	whole model needs so it can be carved out of a single arena.
+	 */
+	if ((header.ident != MD3_MAGIC_NUMBER_LITTLE_ENDIAN) ||
+		(header.ofs_eof > header.file_len) ||
+		(header.num_frames <= 0) || (header.num_frames > MD3_MAX_FRAMES) ||
+		(header.num_tags < 0) || (header.num_tags > MD3_MAX_TAGS) ||
+		(header.num_surfaces < 0) || (header.num_surfaces > MD3_MAX_SURFACES) ||
+		!MD3_IN_BOUNDS(&header, header.ofs_frames, header.num_frames, MD3_SIZEOF_FRAME) ||
+		!MD3_IN_BOUNDS(&header, header.ofs_tags, (header.num_tags * header.num_frames), MD3_SIZEOF_TAG) ||
+		!(size = md3_model_size(&header)))
+	{
+		printf("ERROR: Model file \"%s\" is corrupt.\n", file);
+		unmap_file(header.dptr, header.file_len);
+		return NULL;
+	}
+	
+	arena = arena_create(size);
+	if (!arena) {
+		printf("ERROR: Out of memory loading model file \"%s\".\n", file);
+		unmap_file(header.dptr, header.file_len);
+		return NULL;
+	}
+	
+	model = (struct md3_model_t*)arena_alloc(arena, sizeof(struct md3_model_t));
+	memcpy(model, &header, sizeof(struct md3_model_t));
+	model->arena = arena;
+	
+	/* the node the world will track this model with */
+	model->world_link = (struct world_link_models_t*)arena_alloc(arena, sizeof(struct world_link_models_t));
+	
 	/* FRAMES */
-	LOAD_ARRAY(model->frames, struct md3_frame_t, model->num_frames, 0, model->ofs_frames, model->fptr);
+	LOAD_ARRAY(model->frames, struct md3_frame_t, model->num_frames, 0, model->ofs_frames, model->dptr, arena);
 
 	#ifdef MD3_DEBUG
 	printf("Frames loaded: %i\n", i);
@@ -134,11 +267,14 @@ struct md3_model_t* md3_load_model(char* file, char* texture_path_prefix) {
 	#endif
 
 	/* TAGS */
-	LOAD_ARRAY(model->tags, struct md3_tag_t, (model->num_tags * model->num_frames), 0, model->ofs_tags, model->fptr);
+	LOAD_ARRAY(model->tags, struct md3_tag_t, (model->num_tags * model->num_frames), 0, model->ofs_tags, model->dptr, arena);
+	
+	/* the renderer slerps between tags so convert them now rather than every frame */
+	model->tag_poses = (struct md3_tag_pose_t*)arena_alloc(arena, sizeof(struct md3_tag_pose_t) * model->num_tags * model->num_frames);
+	md3_build_tag_poses(model);
 	
 	/* links - depend on number of tags (actual links are made later) */
-	model->links = (struct md3_model_t**)malloc(sizeof(struct md3_model_t*) * model->num_tags);
-	memset(model->links, 0, (sizeof(struct md3_model_t*) * model->num_tags));
+	model->links = (struct md3_model_t**)arena_alloc(arena, sizeof(struct md3_model_t*) * model->num_tags);
 
 	#ifdef MD3_DEBUG
 	printf("Tags loaded: %i\n", i);
@@ -148,14 +284,15 @@ struct md3_model_t* md3_load_model(char* file, char* texture_path_prefix) {
 	#endif
 
 	/* SURFACES */
-	md3_load_surfaces(model, texture_path_prefix);
+	md3_load_surfaces(model);
 
 	#ifdef MD3_DEBUG
 	printf("Surfaces loaded: %i\n", model->num_surfaces);
 	{
-		struct md3_surface_t* sptr = model->surface_ptr;
+		struct md3_surface_t* sptr = NULL;
 		int sn = 0;
-		while (sptr) {
+		for (; sn < model->num_surfaces; ++sn) {
+			sptr = &model->surfaces[sn];
 			printf("Surface %i:\n", sn);
 			printf("\tname: [%s]\n", sptr->name);
 			printf("\tflags: %i\n", sptr->flags);
@@ -168,65 +305,137 @@ struct md3_model_t* md3_load_model(char* file, char* texture_path_prefix) {
 			printf("\tofs_st: %i\n", sptr->ofs_st);
 			printf("\tofs_xyznormal: %i\n", sptr->ofs_xyznormal);
 			printf("\tofs_end: %i\n", sptr->ofs_end);
-			sptr = sptr->next;
-			++sn;
 		}
 	}
 	#endif
 	
-	/* close the file */
-	fclose(model->fptr);
+	/* release the file */
+	unmap_file(model->dptr, model->file_len);
+	model->dptr = NULL;
 	
-	/* initialize the animation state */
-	model->anim_state.anim_info = NULL;
-	model->anim_state.id = 0;
-	model->anim_state.frame = 0;
-	model->anim_state.next_frame = 0;
-	model->anim_state.t = 0;
-	model->anim_state.last_time = 0.0;
-	model->anim_state.animated = 0;
+	return model;
+}
+
+
+/*
+ *	Check every surface in the mapped model file and
+ *	return the size of the arena needed to hold the
+ *	entire model.
+ *
+ *	Returns 0 if any surface data is not within the
+ *	bounds of the file.
+ */
+static size_t md3_model_size(struct md3_model_t* header) {
+	struct md3_surface_t surf;
+	struct md3_triangle_t tri;
+	byte* src = NULL;
+	long surface_start = header->ofs_surfaces;
+	int surface = 0;
+	int i = 0;
+	int c = 0;
+	size_t size = 0;
 	
-	/* initialize custom rotation */
-	model->rot[0] = 0.0f;
-	model->rot[1] = 0.0f;
-	model->rot[2] = 0.0f;
-	model->scale_factor = 1.0f;
+	size += ARENA_SIZEOF(sizeof(struct md3_model_t));
+	size += ARENA_SIZEOF(sizeof(struct world_link_models_t));
+	size += ARENA_SIZEOF(sizeof(struct md3_frame_t) * header->num_frames);
+	size += ARENA_SIZEOF(sizeof(struct md3_tag_t) * header->num_tags * header->num_frames);
+	size += ARENA_SIZEOF(sizeof(struct md3_tag_pose_t) * header->num_tags * header->num_frames);
+	size += ARENA_SIZEOF(sizeof(struct md3_model_t*) * header->num_tags);
+	size += ARENA_SIZEOF(sizeof(struct md3_surface_t) * header->num_surfaces);
 	
-	return model;
+	for (; surface < header->num_surfaces; ++surface) {
+		if (!MD3_IN_BOUNDS(header, surface_start, 1, MD3_SIZEOF_SURFACE))
+			return 0;
+		memcpy(&surf.ident, (header->dptr + surface_start), MD3_SIZEOF_SURFACE);
+		
+		if ((surf.num_frames <= 0) || (surf.num_frames > MD3_MAX_FRAMES) ||
+			(surf.num_verts < 0) || (surf.num_verts > (INT_MAX / surf.num_frames)) ||
+			!md3_surface_in_bounds(header, surface_start, surf.ofs_shaders, surf.num_shaders, MD3_SIZEOF_SHADER) ||
+			!md3_surface_in_bounds(header, surface_start, surf.ofs_triangles, surf.num_triangles, MD3_SIZEOF_TRIANGLE) ||
+			!md3_surface_in_bounds(header, surface_start, surf.ofs_st, surf.num_verts, MD3_SIZEOF_TEXCOORD) ||
+			!md3_surface_in_bounds(header, surface_start, surf.ofs_xyznormal, (surf.num_verts * surf.num_frames), MD3_SIZEOF_VERTEX))
+			return 0;
+		
+		/* every corner must reference a vertex of this surface */
+		src = (header->dptr + surface_start + surf.ofs_triangles);
+		for (i = 0; i < surf.num_triangles; ++i, src += MD3_SIZEOF_TRIANGLE) {
+			memcpy(&tri, src, MD3_SIZEOF_TRIANGLE);
+			for (c = 0; c < 3; ++c) {
+				if ((unsigned int)tri.index[c] >= (unsigned int)surf.num_verts)
+					return 0;
+			}
+		}
+		
+		size += ARENA_SIZEOF(sizeof(struct md3_shader_t) * surf.num_shaders);
+		size += ARENA_SIZEOF(sizeof(int) * 3 * surf.num_triangles);
+		size += ARENA_SIZEOF(sizeof(float) * 2 * surf.num_verts);
+		size += ARENA_SIZEOF(sizeof(short) * 3 * surf.num_verts * surf.num_frames);
+		size += ARENA_SIZEOF(sizeof(unsigned short) * surf.num_verts * surf.num_frames);
+		size += ARENA_SIZEOF(sizeof(struct md3_cached_frame_t*) * surf.num_frames);
+		size += ARENA_SIZEOF(sizeof(struct md3_bounds_t) * surf.num_frames);
+		
+		/* the next surface must be further on (the last one's ofs_end is not used) */
+		if ((surface + 1) < header->num_surfaces) {
+			if ((surf.ofs_end <= 0) || (surf.ofs_end > (header->ofs_eof - surface_start)))
+				return 0;
+			surface_start += surf.ofs_end;
+		}
+	}
+	
+	return size;
+}
+
+
+/*
+ *	Check that a block of elements objects of size bytes at offset
+ *	from the start of a surface lies within the MD3 data, without
+ *	adding anything that could overflow before it is checked.
+ *	surface_start must itself be within the data.
+ */
+static int md3_surface_in_bounds(struct md3_model_t* header, long surface_start, int offset, int elements, size_t size) {
+	if ((offset < 0) || (offset > (header->ofs_eof - surface_start)))
+		return 0;
+	
+	return MD3_IN_BOUNDS(header, (surface_start + offset), elements, size);
 }
 
 
-static void md3_load_surfaces(struct md3_model_t* model, char* texture_path_prefix) {
+/*
+ *	Load all the surfaces from the model file in memory.
+ *	The file must have been checked by md3_model_size().
+ */
+static void md3_load_surfaces(struct md3_model_t* model) {
 	struct md3_surface_t* sptr = NULL;
-	int surface_base = 0;
-	int surface_start = 0;
-	int shader_base = 0;
-	int vert_base = 0;
+	byte* src = NULL;
+	long surface_start = 0;
 	int surface = 0;
 	int i = 0;
-	char text_file[1024];
 	
-	/* assume there is at least 1 surface */
-	model->surface_ptr = (struct md3_surface_t*)malloc(sizeof(struct md3_surface_t));
-	memset(model->surface_ptr, 0, sizeof(struct md3_surface_t));
-	sptr = model->surface_ptr;
+	#ifdef MD3_DEBUG
+	float misses_before = 0;
+	float misses_after = 0;
+	#endif
+	
+	if (!model->num_surfaces)
+		return;
+	
+	model->surfaces = (struct md3_surface_t*)arena_alloc(model->arena, sizeof(struct md3_surface_t) * model->num_surfaces);
 	
 	/* calculate where surfaces start */
-	surface_base = model->ofs_surfaces;
-	surface_start = surface_base;
+	surface_start = model->ofs_surfaces;
 	
 	/* iterate through each surface */
 	for (; surface < model->num_surfaces; ++surface) {
+		sptr = &model->surfaces[surface];
+		
 		/* load in surface data */
-		fseek(model->fptr, surface_start, SEEK_SET);
-		fread(&sptr->ident, ((sizeof(int) * 11) + (sizeof(char) * MAX_QPATH)), 1, model->fptr);
+		memcpy(&sptr->ident, (model->dptr + surface_start), MD3_SIZEOF_SURFACE);
 		
 		/* load shaders */
-		sptr->shader = (struct md3_shader_t*)malloc(sizeof(struct md3_shader_t) * sptr->num_shaders);
-		shader_base = (surface_start + sptr->ofs_shaders);
-		for (i = 0; i < sptr->num_shaders; ++i) {
-			fseek(model->fptr, (shader_base + (i * MD3_SIZEOF_SHADER)), SEEK_SET);
-			fread(sptr->shader + i, MD3_SIZEOF_SHADER, 1, model->fptr);
+		sptr->shader = (struct md3_shader_t*)arena_alloc(model->arena, sizeof(struct md3_shader_t) * sptr->num_shaders);
+		src = (model->dptr + surface_start + sptr->ofs_shaders);
+		for (i = 0; i < sptr->num_shaders; ++i, src += MD3_SIZEOF_SHADER) {
+			memcpy(sptr->shader + i, src, MD3_SIZEOF_SHADER);
 			
 			/*
 			 *	For some reason or another shader names may start with a '\0'.
@@ -234,82 +443,259 @@ static void md3_load_surfaces(struct md3_model_t* model, char* texture_path_pref
 			 */
 			if (sptr->shader[i].name[0] == '\0')
 				sptr->shader[i].name[0] = 'm';
+			sptr->shader[i].name[MAX_QPATH - 1] = '\0';
 			
+			/* textures are loaded later */
+			sptr->shader[i].texture = NULL;
 			sptr->shader[i].gl_text_id = NULL;
 			sptr->shader[i].gl_text_bound = NULL;
-			
-			/* load the texture */
-			if (!texture_path_prefix) {
-				/* using the skin config stuff */
-				sptr->shader[i].texture = NULL;
-			} else {
-				/* use the texture within the file */			
-				str_to_lower(sptr->shader[i].name);
-				sprintf(text_file, "%s%s", (texture_path_prefix ? texture_path_prefix : ""), sptr->shader[i].name);
-				format_path_for_os(text_file);
-				sptr->shader[i].texture = world_texture_cached(g_world, text_file, &sptr->shader[i]);
-				if (!sptr->shader[i].texture) {
-					/* if texture not already cached, load it */
-					sptr->shader[i].texture = load_tga(text_file);
-					
-					if (sptr->shader[i].texture) {
-						/* register it with the world */
-						world_add_texture(g_world, sptr->shader[i].texture, text_file, &sptr->shader[i]);
-	
-						#ifdef MD3_DEBUG
-						printf("Texture \"%s\" loaded.\n", text_file);
-						#endif
-					}
-				} else {
-					/* tell the world we need to use this texture */
-					world_using_texture(g_world, sptr->shader[i].texture);
-					
-					/* if the texture id is not -1 then it has already been bound in GL */
-	
-					#ifdef MD3_DEBUG
-					printf("Texture \"%s\" loaded (cached).\n", text_file);
-					#endif
-				}
-						
-				if (!sptr->shader[i].texture)
-					printf("Error: Unable to load texture \"%s\".\n", text_file);
-			}
 		}
 		
 		/* load triangles */
-		LOAD_ARRAY(sptr->triangle, struct md3_triangle_t, sptr->num_triangles, surface_start, sptr->ofs_triangles, model->fptr);
+		LOAD_ARRAY(sptr->indices, int, (sptr->num_triangles * 3), surface_start, sptr->ofs_triangles, model->dptr, model->arena);
 		model->total_triangles += sptr->num_triangles;
 			
 		/* load texture coordinates */
-		LOAD_ARRAY(sptr->st, struct md3_texcoord_t, sptr->num_verts, surface_start, sptr->ofs_st, model->fptr);
+		LOAD_ARRAY(sptr->st, float, (sptr->num_verts * 2), surface_start, sptr->ofs_st, model->dptr, model->arena);
 			
-		/* load verticies */
-		sptr->vertex = (struct md3_vertex_t*)malloc(sizeof(struct md3_vertex_t) * (sptr->num_verts * sptr->num_frames));
-		vert_base = (surface_start + sptr->ofs_xyznormal);
-		for (i = 0; i < (sptr->num_frames * sptr->num_verts); ++i) {
-			fseek(model->fptr, (vert_base + (i * MD3_SIZEOF_VERTEX)), SEEK_SET);
-			fread(sptr->vertex + i, MD3_SIZEOF_VERTEX, 1, model->fptr);
-
-			/* Calculate xyz normal */
-			md3_make_normal(sptr->vertex + i);
-		}
+		/* load verticies for every frame - frames are decoded when they are used */
+		sptr->xyz = (short*)arena_alloc(model->arena, sizeof(short) * 3 * sptr->num_verts * sptr->num_frames);
+		sptr->normals = (unsigned short*)arena_alloc(model->arena, sizeof(unsigned short) * sptr->num_verts * sptr->num_frames);
+		md3_split_vertices((model->dptr + surface_start + sptr->ofs_xyznormal), (sptr->num_verts * sptr->num_frames), sptr->xyz, sptr->normals);
+		
+		/*
+		 *	Optimization.
+		 *	Reorder the triangles and verticies for the vertex caches
+		 *	(once, the cook keeps the new order).
+		 */
+		#ifdef MD3_DEBUG
+		misses_before += (md3_acmr(sptr->indices, sptr->num_triangles, sptr->num_verts) * sptr->num_triangles);
+		#endif
+		md3_optimize_surface(sptr);
+		#ifdef MD3_DEBUG
+		misses_after += (md3_acmr(sptr->indices, sptr->num_triangles, sptr->num_verts) * sptr->num_triangles);
+		#endif
 		
-		/* go to start of next surface */
-		if ((surface + 1) < model->num_surfaces) {
+		sptr->cached_frames = (struct md3_cached_frame_t**)arena_alloc(model->arena, sizeof(struct md3_cached_frame_t*) * sptr->num_frames);
+		
+		/* bounds of the surface in each frame */
+		sptr->bounds = (struct md3_bounds_t*)arena_alloc(model->arena, sizeof(struct md3_bounds_t) * sptr->num_frames);
+		md3_build_bounds(sptr);
+		
+		/* on to the next surface */
+		if ((surface + 1) < model->num_surfaces)
 			surface_start += sptr->ofs_end;
-			sptr->next = (struct md3_surface_t*)malloc(sizeof(struct md3_surface_t));
-			memset(sptr->next, 0, sizeof(struct md3_surface_t));
-			sptr = sptr->next;
+	}
+	
+	#ifdef MD3_DEBUG
+	if (model->total_triangles)
+		printf("Model \"%s\" vertex cache misses per triangle: %.3f, %.3f before reordering.\n",
+			   model->name, (misses_after / model->total_triangles), (misses_before / model->total_triangles));
+	#endif
+}
+
+
+/*
+ *	Convert every tag orientation into a quaternion.
+ */
+static void md3_build_tag_poses(struct md3_model_t* model) {
+	struct quat_t q;
+	int i = 0;
+	
+	for (; i < (model->num_tags * model->num_frames); ++i) {
+		quat_from_matrix_3x3(&q, (float*)model->tags[i].axis);
+		model->tag_poses[i].quat[0] = q.x;
+		model->tag_poses[i].quat[1] = q.y;
+		model->tag_poses[i].quat[2] = q.z;
+		model->tag_poses[i].quat[3] = q.w;
+		model->tag_poses[i].origin = model->tags[i].origin;
+	}
+}
+
+
+/*
+ *	Split count MD3 verticies (MD3_SIZEOF_VERTEX bytes each)
+ *	into their coordinates and encoded normals.
+ */
+static void md3_split_vertices(byte* src, int count, short* xyz, unsigned short* normals) {
+	short v[4];
+	int i = 0;
+	
+	for (; i < count; ++i, src += MD3_SIZEOF_VERTEX, xyz += 3) {
+		memcpy(v, src, MD3_SIZEOF_VERTEX);
+		xyz[0] = v[0];
+		xyz[1] = v[1];
+		xyz[2] = v[2];
+		normals[i] = (unsigned short)v[3];
+	}
+}
+
+
+/*
+ *	Find the bounds of a surface in each of its frames.
+ */
+static void md3_build_bounds(struct md3_surface_t* sptr) {
+	short* vptr = sptr->xyz;
+	struct md3_bounds_t* b = NULL;
+	short mins[3];
+	short maxs[3];
+	int frame = 0;
+	int v = 0;
+	int i = 0;
+	
+	/* the bounds are found on the encoded verticies and scaled afterwards */
+	for (; frame < sptr->num_frames; ++frame) {
+		b = &sptr->bounds[frame];
+		memset(b, 0, sizeof(struct md3_bounds_t));
+		if (!sptr->num_verts)
+			continue;
+		
+		for (i = 0; i < 3; ++i)
+			mins[i] = maxs[i] = vptr[i];
+		
+		for (v = 0; v < sptr->num_verts; ++v, vptr += 3) {
+			for (i = 0; i < 3; ++i) {
+				if (vptr[i] < mins[i]) mins[i] = vptr[i];
+				if (vptr[i] > maxs[i]) maxs[i] = vptr[i];
+			}
 		}
+		
+		b->min_bounds.x = (mins[0] * MD3_XYZ_SCALE);
+		b->min_bounds.y = (mins[1] * MD3_XYZ_SCALE);
+		b->min_bounds.z = (mins[2] * MD3_XYZ_SCALE);
+		b->max_bounds.x = (maxs[0] * MD3_XYZ_SCALE);
+		b->max_bounds.y = (maxs[1] * MD3_XYZ_SCALE);
+		b->max_bounds.z = (maxs[2] * MD3_XYZ_SCALE);
 	}
 }
 
 
+/*
+ *	Load (or find the already loaded) texture for a shader.
+ *
+ *	If decoded points to a texture already read from text_file
+ *	(ie: on the thread pool) it is used instead of reading the file,
+ *	and *decoded is set to NULL since the world now owns it.
+ */
+void md3_load_texture(struct md3_shader_t* shader, char* text_file, struct tga_t** decoded) {
+	format_path_for_os(text_file);
+	
+	shader->texture = world_texture_cached(g_world, text_file, shader);
+	if (!shader->texture) {
+		/* if texture not already cached, load it */
+		if (decoded && *decoded) {
+			shader->texture = *decoded;
+			*decoded = NULL;
+		} else
+			shader->texture = load_tga(text_file);
+		
+		if (shader->texture) {
+			/* register it with the world (it may be the same as one already loaded) */
+			shader->texture = world_add_texture(g_world, shader->texture, text_file, shader);
+
+			#ifdef MD3_DEBUG
+			printf("Texture \"%s\" loaded.\n", text_file);
+			#endif
+		}
+	} else {
+		/* tell the world we need to use this texture */
+		world_using_texture(g_world, shader->texture);
+		
+		/* if the texture id is not -1 then it has already been bound in GL */
+
+		#ifdef MD3_DEBUG
+		printf("Texture \"%s\" loaded (cached).\n", text_file);
+		#endif
+	}
+			
+	if (!shader->texture)
+		printf("Error: Unable to load texture \"%s\".\n", text_file);
+}
+
+
+/*
+ *	Load the textures named by the shaders within the MD3.
+ */
+static void md3_load_prefix_textures(struct md3_model_t* model, char* texture_path_prefix, struct md3_plan_part_t* part) {
+	struct md3_surface_t* sptr = NULL;
+	char text_file[1024];
+	int surface = 0;
+	int i = 0;
+	
+	for (; surface < model->num_surfaces; ++surface) {
+		sptr = &model->surfaces[surface];
+		for (i = 0; i < sptr->num_shaders; ++i) {
+			str_to_lower(sptr->shader[i].name);
+			sprintf(text_file, "%s%s", texture_path_prefix, sptr->shader[i].name);
+			format_path_for_os(text_file);
+			md3_load_texture(&sptr->shader[i], text_file, (part ? md3_plan_texture(NULL, part, text_file) : NULL));
+		}
+	}
+}
+
+
+/*
+ *	Load the textures the skin resolved to when the model was cooked.
+ */
+static void md3_load_cooked_textures(struct md3_model_t* model, struct md3_load_plan_t* plan) {
+	struct md3_surface_t* sptr = NULL;
+	char text_file[1024];
+	char* cooked = NULL;
+	int surface = 0;
+	int i = 0;
+	
+	for (; surface < model->num_surfaces; ++surface) {
+		sptr = &model->surfaces[surface];
+		for (i = 0; i < sptr->num_shaders; ++i) {
+			cooked = md3_cooked_texture(model, surface, i);
+			if (!cooked)
+				continue;
+			
+			/* the cook is read only */
+			strcpy(text_file, cooked);
+			md3_load_texture(&sptr->shader[i], text_file, md3_plan_texture(plan, NULL, text_file));
+		}
+	}
+}
+
+
+/*
+ *	Free a model that was never handed to the world.
+ */
+static void md3_free_model(struct md3_model_t* model) {
+	int surface = 0;
+	
+	if (!model)
+		return;
+	
+	/* the frame cache and OpenGL must let go of the surfaces */
+	for (; surface < model->num_surfaces; ++surface) {
+		md3_frame_cache_drop(&model->surfaces[surface]);
+		md3_vbo_drop(&model->surfaces[surface]);
+		free(model->surfaces[surface].posed);
+	}
+	
+	/* the arrays of a cooked model point into the cook */
+	if (model->cooked)
+		unmap_file(model->cooked, model->cooked_len);
+	
+	free(model->atlas_st);
+	free(model->pose.tags);
+	
+	/*
+	 *	Everything else, including the model itself,
+	 *	was allocated from the model's arena.
+	 */
+	arena_free(model->arena);
+}
+
+
 /*
  *	Unload a model and deallocate memory used by the structures.
  */
 void md3_unload_model(struct md3_model_t* model) {
-	struct md3_surface_t* next_surface = NULL;
+	struct md3_surface_t* sptr = NULL;
+	int surface = 0;
 	int i = 0;
 
 	if (!model)
@@ -317,115 +703,147 @@ void md3_unload_model(struct md3_model_t* model) {
 	
 	/* tell the world */
 	world_del_model(g_world, model);
+	
+	/* unload textures - tell the world we no longer need them */
+	for (; surface < model->num_surfaces; ++surface) {
+		sptr = &model->surfaces[surface];
+		for (i = 0; i < sptr->num_shaders; ++i)
+			world_not_using_texture(g_world, sptr->shader[i].texture);
+	}
+	
+	md3_free_model(model);
+}
 
-	/* free frames */
-	free(model->frames);
-		
-	/* free tags */
-	free(model->tags);
-		
-	/* free surfaces */
-	while (model->surface_ptr) {
-		next_surface = model->surface_ptr->next;
-		
-		/* unload textures - tell the world we no longer need them */
-		for (i = 0; i < model->surface_ptr->num_shaders; ++i)
-			world_not_using_texture(g_world, model->surface_ptr->shader[i].texture);
-		
-		/* free shaders */
-		free(model->surface_ptr->shader);
-			
-		/* free triangles */
-		free(model->surface_ptr->triangle);
-			
-		/* free vertexes */
-		free(model->surface_ptr->vertex);
 
-		/* free surface */
-		free(model->surface_ptr);
-		
-		model->surface_ptr = next_surface;
+/*
+ *	Load a full model.
+ *
+ *	The file should consist of 1 line per body part in the form:
+ *		name file
+ *		name file
+ *		...
+ *
+ *	Where "name" is the body part name and "file" is a relative
+ *	path from this file to the md3 file.
+ *
+ *	Returns root model loaded.
+ */
+struct md3_model_t* load_model(char* file) {
+	struct md3_load_plan_t* plan = md3_plan_create();
+	struct md3_model_t* model = NULL;
+	
+	if (!plan)
+		return NULL;
+	
+	if (md3_plan_add_model(plan, file)) {
+		md3_plan_run(plan, g_world->pool);
+		model = md3_plan_finish(plan);
 	}
 	
-	/* free the model name */
-	free(model->model_name);
+	md3_plan_free(plan);
+	
+	return model;
+}
+
+
+/*
+ *	Unload a full model starting at the given root.
+ *
+ *	If unload_weapon_link is 0 the weapon link will not be unloaded.
+ */
+void unload_model(struct md3_model_t* model, int unload_weapon_link) {
+	int link = 0;
+	
+	if (!model)
+		return;
+	
+	if ((!unload_weapon_link) && (model->body_part == MD3_WEAPON))
+		/* we do not want to unload the weapon, just skip it */
+		return;
+	
+	/* First unload all the links to this model */
+	for (; link < model->num_tags; ++link)
+		unload_model(model->links[link], unload_weapon_link);
+	
+	/* Unload the model - md3_unload_model() will tell the world for us */
+	md3_unload_model(model);
+}
+
+
+/*
+ *	Load a weapon and add to the world.
+ */
+struct md3_model_t* load_weapon(char* path, char* texture_path_prefix) {
+	struct md3_load_plan_t* plan = md3_plan_create();
+	struct md3_model_t* w = NULL;
+	
+	if (!plan)
+		return NULL;
 	
-	/* free array of links */
-	free(model->links);
+	if (md3_plan_add_weapon(plan, path, texture_path_prefix)) {
+		md3_plan_run(plan, g_world->pool);
+		md3_plan_finish(plan);
+		w = plan->weapon;
+	}
 	
-	/* free model */
-	free(model);
+	md3_plan_free(plan);
 	
+	return w;
 }
 
 
 /*
- *	This code is modified from the Quake3 source code base.
- *	File: code/q3map/misc_model.c:InsertMD3Model()
- *
- *	It will decode the xyz normal short in the form:
- *		8 significant bits = lat
- *		8 least sig bits = lng
- *	To x, y, z coordinates.
+ *	Unload a weapon and delete from the world.
+ */
+void unload_weapon(struct md3_model_t* w) {
+	world_delink_model(g_world, w);
+	world_del_model(g_world, w);
+	md3_unload_model(w);
+}
+	
+	
+/*
+ *	Create an empty load plan.
  */
-static void md3_make_normal(struct md3_vertex_t* vertex) {
-	float lat, lng;
-	
-	/* decode */
-	lat = ((vertex->normal >> 8) & 0xFF);
-	lng = (vertex->normal & 0xFF);
-	lat *= (PI / 128);
-	lng *= (PI / 128);
-
-	vertex->normalxyz[0] = cos(lat) * sin(lng);
-	vertex->normalxyz[1] = sin(lat) * sin(lng);
-	vertex->normalxyz[2] = cos(lng);
+struct md3_load_plan_t* md3_plan_create() {
+	struct md3_load_plan_t* plan = (struct md3_load_plan_t*)malloc(sizeof(struct md3_load_plan_t));
+	if (plan)
+		memset(plan, 0, sizeof(struct md3_load_plan_t));
+	return plan;
 }
 
 
 /*
- *	Load a full model.
- *
- *	The file should consist of 1 line per body part in the form:
- *		name file
- *		name file
- *		...
+ *	Add every body part, texture and animation of a .mod file to the plan.
  *
- *	Where "name" is the body part name and "file" is a relative
- *	path from this file to the md3 file.
+ *	Lines are in the form:
+ *		m name file				- body part MD3 relative to the .mod file
+ *		a file					- animation config relative to the .mod file
+ *		t name surface file		- texture relative to the parent directory
  *
- *	Returns root model loaded.
+ *	Returns 0 if the file could not be read.
  */
-struct md3_model_t* load_model(char* file) {
+int md3_plan_add_model(struct md3_load_plan_t* plan, char* file) {
 	FILE* fptr = NULL;
 	char* path = NULL;
+	char* text_path = NULL;
 	char buf[1024];
 	char name[64];
 	char mfile[1024];
 	char line_type;
-	struct md3_model_t* model = NULL;
-	char* text_path = NULL;
-	int root_model = 1;
-	
-	struct md3_model_t* models[10] = {0};
-	int loaded = 0;
+	struct md3_plan_part_t* part = NULL;
+	struct md3_plan_skin_t* skin = NULL;
 	int i = 0;
 	
 	fptr = fopen(file, "r");
 	if (!fptr)
-		return NULL;
+		return 0;
+	
+	strcpy(plan->mod_file, file);
 	
 	path = get_path(file, 1);
 	text_path = get_path(path, 1);
 	
-	/*
-	 *	each line in the file is the
-	 *	path to a md3 model file
-	 *	relative to this file
-	 *
-	 *	In the form:
-	 *		name file
-	 */
 	while (!feof(fptr)) {
 		line_type = fgetc(fptr);
 		fgetc(fptr);	/* next char always a space */
@@ -435,59 +853,39 @@ struct md3_model_t* load_model(char* file) {
 		strip_lf(buf);
 
 		if (line_type == 'm') {
-			/* model line */		
+			/* model line */
+			if (plan->num_parts >= MD3_PLAN_MAX_PARTS) {
+				printf("Error: Too many models in \"%s\".\n", file);
+				continue;
+			}
+			
 			sscanf(buf, "%s %s", name, mfile);
-		
+			
+			part = &plan->parts[plan->num_parts++];
+			part->plan = plan;
+			strcpy(part->name, name);
+			
 			/* make the relative path from this binary */
-			sprintf(buf, "%s%s", (path ? path : ""), mfile);
-		
-			/* load the model */
-			model = md3_load_model(buf, NULL);
-		
-			if (!model)
-				continue;
-		
-			/* assign our custom name to this model */
-			model->model_name = strdup(name);
+			sprintf(part->file, "%s%s", (path ? path : ""), mfile);
+			
 			if (!strcmp(name, "upper"))
-				model->body_part = MD3_TORSO;
+				part->body_part = MD3_TORSO;
 			else if (!strcmp(name, "lower"))
-				model->body_part = MD3_LEGS;
+				part->body_part = MD3_LEGS;
 			else if (!strcmp(name, "head"))
-				model->body_part = MD3_HEAD;
-		
-			/* add the model to the world */
-			world_add_model(g_world, model, root_model);
-					
-			/* link this model to the others */
-			for (i = 0; i < loaded; ++i) {
-				if (models[i])
-					md3_link_models(models[i], model);
-			}
-					
-			/* keep track of this model */
-			models[loaded] = model;
-			++loaded;
-				
-			/* only the first model in the file is considered the root model */
-			root_model = 0;
+				part->body_part = MD3_HEAD;
 		} else if (line_type == 'a') {
-			/* Load the animation data for this model */
-
-			/* make the relative path from this binary */
-			strcpy(name, buf);
-			sprintf(buf, "%s%s", (path ? path : ""), name);
-
-			load_anim_file(buf, g_world->anims);
-		} else if (line_type == 't') {		
-			/* Load textures for this model */
+			/* animation data for this model */
+			sprintf(plan->anim_file, "%s%s", (path ? path : ""), buf);
+		} else if (line_type == 't') {
+			/* texture for a surface of a model */
 			char model[64];
 			char surface[64];
-			int m = 0;
 			enum MD3_BODY_PARTS model_type = 0;
-				
+			
 			sscanf(buf, "%s %s %s", model, surface, name);
 			sprintf(mfile, "%s%s", (text_path ? text_path : ""), name);
+			format_path_for_os(mfile);
 			
 			if (!strcmp(model, "upper"))
 				model_type = MD3_TORSO;
@@ -496,78 +894,510 @@ struct md3_model_t* load_model(char* file) {
 			else if (!strcmp(model, "head"))
 				model_type = MD3_HEAD;
 			
-			/* Get the model this texture belongs to */
-			for (; m < loaded; ++m) {
-				if (models[m]->body_part == model_type) {
-					/* this is the model - find the surface */
-					load_texture_for_model(models[m], mfile, surface);
+			if (plan->num_skins >= MD3_PLAN_MAX_SKINS) {
+				printf("Error: Too many textures in \"%s\".\n", file);
+				continue;
+			}
+			skin = &plan->skins[plan->num_skins];
+			strcpy(skin->surface, surface);
+			
+			/* get the model this texture belongs to */
+			for (skin->part = 0; skin->part < plan->num_parts; ++skin->part) {
+				if (plan->parts[skin->part].body_part == model_type)
 					break;
+			}
+			if (skin->part == plan->num_parts)
+				continue;
+			
+			/* each texture is only read once */
+			for (i = 0; i < plan->num_textures; ++i) {
+				if (!strcmp(plan->textures[i].file, mfile))
+					break;
+			}
+			if (i == plan->num_textures) {
+				if (plan->num_textures >= MD3_PLAN_MAX_TEXTURES) {
+					printf("Error: Too many textures in \"%s\".\n", file);
+					continue;
 				}
+				strcpy(plan->textures[plan->num_textures].file, mfile);
+				plan->textures[plan->num_textures].cached = (world_texture_cached(g_world, mfile, NULL) != NULL);
+				++plan->num_textures;
 			}
+			skin->texture = i;
 			
+			++plan->num_skins;
 		}
 	}
+	
+	fclose(fptr);
 
 	if (path)
 		free(path);
 	if (text_path)
 		free(text_path);
 	
-	fclose(fptr);
+	return 1;
+}
+
+
+/*
+ *	Add a weapon to the plan.
+ *	The weapon uses the textures named within the MD3.
+ *
+ *	Returns 0 if there is no room in the plan.
+ */
+int md3_plan_add_weapon(struct md3_load_plan_t* plan, char* path, char* texture_path_prefix) {
+	struct md3_plan_part_t* part = NULL;
+	
+	if (plan->num_parts >= MD3_PLAN_MAX_PARTS)
+		return 0;
 	
-	return *models;
+	part = &plan->parts[plan->num_parts++];
+	part->plan = plan;
+	strcpy(part->name, "weapon");
+	strcpy(part->file, path);
+	strcpy(part->texture_path_prefix, (texture_path_prefix ? texture_path_prefix : ""));
+	part->use_prefix = 1;
+	part->body_part = MD3_WEAPON;
+	
+	return 1;
 }
 
 
 /*
- *	Unload a full model starting at the given root.
+ *	Read every file in the plan.
  *
- *	If unload_weapon_link is 0 the weapon link will not be unloaded.
+ *	Optimization.
+ *
+ *	Each MD3 and TGA is read by its own job on the thread pool, so
+ *	loading a character takes about as long as its largest file.
+ *	Textures the world already had when the plan was made are not read again.
+ *	The textures named within a weapon's MD3 are only known once it
+ *	has been read, so they are checked and read in a second round,
+ *	along with the character's atlas which needs every texture read.
+ *
+ *	The jobs never touch the world; anything read here is handed to
+ *	it by md3_plan_finish().
  */
-void unload_model(struct md3_model_t* model, int unload_weapon_link) {
-	int link = 0;
+void md3_plan_run(struct md3_load_plan_t* plan, struct thread_pool_t* pool) {
+	md3_plan_start(plan, pool);
+	thread_pool_wait(pool, &plan->group);
 	
-	if (!model)
+	if (md3_plan_queue_second_round(plan))
+		thread_pool_wait(pool, &plan->group);
+}
+
+
+/*
+ *	Start reading every file in the plan in the background.
+ *	See md3_plan_run().
+ *
+ *	If there is no pool (it could not be created) every file
+ *	is read here and the plan is ready as soon as this returns.
+ */
+void md3_plan_start(struct md3_load_plan_t* plan, struct thread_pool_t* pool) {
+	int i = 0;
+	
+	if (plan->started)
 		return;
+	plan->started = 1;
+	plan->pool = pool;
 	
-	if ((!unload_weapon_link) && (model->body_part == MD3_WEAPON))
-		/* we do not want to unload the weapon, just skip it */
+	/* the MD3 files are the largest so start them first */
+	for (i = 0; i < plan->num_parts; ++i, ++plan->jobs)
+		thread_pool_add(pool, &plan->group, md3_plan_part_job, &plan->parts[i]);
+	
+	for (i = 0; i < plan->num_textures; ++i) {
+		if (!plan->textures[i].cached) {
+			thread_pool_add(pool, &plan->group, md3_plan_texture_job, &plan->textures[i]);
+			++plan->jobs;
+		}
+	}
+	
+	if (*plan->anim_file) {
+		thread_pool_add(pool, &plan->group, md3_plan_anim_job, plan);
+		++plan->jobs;
+	}
+}
+
+
+/*
+ *	Returns 1 once every file in a started plan has been read.
+ */
+int md3_plan_ready(struct md3_load_plan_t* plan) {
+	if (!plan->started || thread_pool_pending(plan->pool, &plan->group))
+		return 0;
+	
+	/* the MD3s are read, now for the textures named within them */
+	md3_plan_queue_second_round(plan);
+	
+	return !thread_pool_pending(plan->pool, &plan->group);
+}
+
+
+/*
+ *	Get how many of the files in a started plan have been read so far.
+ */
+void md3_plan_progress(struct md3_load_plan_t* plan, int* done, int* total) {
+	*total = plan->jobs;
+	*done = (plan->started ? (plan->jobs - thread_pool_pending(plan->pool, &plan->group)) : 0);
+}
+
+
+/*
+ *	Hand everything read by md3_plan_run() to the world.
+ *
+ *	Textures are bound and models are linked and added
+ *	to the world in the order they appear in the plan.
+ *
+ *	Returns the root model.
+ */
+struct md3_model_t* md3_plan_finish(struct md3_load_plan_t* plan) {
+	struct md3_plan_part_t* part = NULL;
+	struct md3_plan_skin_t* skin = NULL;
+	struct md3_model_t* models[MD3_PLAN_MAX_PARTS] = {0};
+	int loaded = 0;
+	int root_model = 1;
+	int i = 0;
+#ifdef USE_TEXTURE_ATLAS
+	char atlas_name[1024];
+#endif
+	
+	if (plan->finished)
+		return plan->root;
+	plan->finished = 1;
+	
+	/* make sure everything has been read */
+	if (plan->started) {
+		thread_pool_wait(plan->pool, &plan->group);
+		if (md3_plan_queue_second_round(plan))
+			thread_pool_wait(plan->pool, &plan->group);
+	}
+	
+	for (part = plan->parts; part < (plan->parts + plan->num_parts); ++part) {
+		if (!part->model)
+			continue;
+		
+		/* assign our custom name to this model */
+		strncpy(part->model->model_name, part->name, MAX_QPATH - 1);
+		part->model->model_name[MAX_QPATH - 1] = '\0';
+		part->model->body_part = part->body_part;
+		
+		if (part->use_prefix) {
+			/* a weapon - textures come from within the MD3 */
+			md3_load_prefix_textures(part->model, part->texture_path_prefix, part);
+			
+			plan->weapon = part->model;
+			world_link_model(g_world, part->model);
+			world_add_model(g_world, part->model, 0);
+			continue;
+		}
+		
+		if (part->model->skinned)
+			/* the cook already knows what the skin resolves to */
+			md3_load_cooked_textures(part->model, plan);
+		else {
+			for (skin = plan->skins; skin < (plan->skins + plan->num_skins); ++skin) {
+				if (skin->part == (part - plan->parts))
+					load_texture_for_model(part->model, plan->textures[skin->texture].file, skin->surface, &plan->textures[skin->texture].tga);
+			}
+		}
+		
+		/* add the model to the world */
+		world_add_model(g_world, part->model, root_model);
+		
+		/* link this model to the others */
+		for (i = 0; i < loaded; ++i)
+			md3_link_models(models[i], part->model);
+		models[loaded++] = part->model;
+		
+		/* only the first model in the file is considered the root model */
+		if (root_model)
+			plan->root = part->model;
+		root_model = 0;
+	}
+	
+	#ifdef USE_TEXTURE_ATLAS
+		/* draw the character with one texture (the weapon keeps its own) */
+		if (plan->atlas && ((strlen(plan->mod_file) + strlen(ATLAS_EXTENSION)) < sizeof(atlas_name))) {
+			sprintf(atlas_name, "%s%s", plan->mod_file, ATLAS_EXTENSION);
+			atlas_apply(plan->atlas, atlas_name);
+		}
+	#endif
+	
+	if (plan->num_anims)
+		memcpy(g_world->anims, plan->anims, sizeof(struct md3_anim_t) * MD3_MAX_ANIMS);
+	
+	return plan->root;
+}
+
+
+/*
+ *	Free a plan.
+ *
+ *	Anything read but not handed to the world
+ *	(or the plan was never finished) is freed.
+ */
+void md3_plan_free(struct md3_load_plan_t* plan) {
+	int i = 0;
+	int t = 0;
+	
+	if (!plan)
 		return;
 	
-	/* First unload all the links to this model */
-	for (; link < model->num_tags; ++link)
-		unload_model(model->links[link], unload_weapon_link);
+	/* a plan can not be stopped part way through reading */
+	if (plan->pool)
+		thread_pool_wait(plan->pool, &plan->group);
 	
-	/* Unload the model - md3_unload_model() will tell the world for us */
-	md3_unload_model(model);
+	for (i = 0; i < plan->num_parts; ++i) {
+		if (!plan->finished)
+			md3_free_model(plan->parts[i].model);
+		for (t = 0; t < plan->parts[i].num_textures; ++t)
+			free_tga(plan->parts[i].textures[t].tga);
+	}
+	
+	for (i = 0; i < plan->num_textures; ++i)
+		free_tga(plan->textures[i].tga);
+	
+	atlas_free(plan->atlas);
+	free(plan);
 }
 
 
 /*
- *	Load a weapon and add to the world.
+ *	Find a texture read by md3_plan_run() for the given file, either
+ *	from the .mod file (plan) or from within a part's MD3 (part).
+ *
+ *	Returns a pointer that can be passed to md3_load_texture(),
+ *	NULL if the texture was not read.
  */
-struct md3_model_t* load_weapon(char* path, char* texture_path_prefix) {
-	struct md3_model_t* w = md3_load_model(path, texture_path_prefix);
-	if (!w)
-		return NULL;
-	w->model_name = strdup("weapon");
-	w->body_part = MD3_WEAPON;
-	world_link_model(g_world, w);
-	world_add_model(g_world, w, 0);
-	return w;
+static struct tga_t** md3_plan_texture(struct md3_load_plan_t* plan, struct md3_plan_part_t* part, char* file) {
+	int i = 0;
+	
+	if (plan) {
+		for (i = 0; i < plan->num_textures; ++i) {
+			if (!strcmp(plan->textures[i].file, file))
+				return &plan->textures[i].tga;
+		}
+	}
+	
+	if (part) {
+		for (i = 0; i < part->num_textures; ++i) {
+			if (!strcmp(part->textures[i].file, file))
+				return &part->textures[i].tga;
+		}
+	}
+	
+	return NULL;
 }
 
 
 /*
- *	Unload a weapon and delete from the world.
+ *	Job - read the MD3 of a part.
+ *
+ *	Parts that use the textures within the MD3 also name them here
+ *	since they are not known until the MD3 has been read.
+ *	Parts using the skin are cooked together with what the skin
+ *	resolves to.
  */
-void unload_weapon(struct md3_model_t* w) {
-	world_delink_model(g_world, w);
-	world_del_model(g_world, w);
-	md3_unload_model(w);
+static void md3_plan_part_job(void* arg) {
+	struct md3_plan_part_t* part = (struct md3_plan_part_t*)arg;
+	struct md3_load_plan_t* plan = part->plan;
+	struct md3_plan_texture_t* tex = NULL;
+	struct md3_surface_t* sptr = NULL;
+	char* textures[MD3_MAX_SURFACES];
+	int surface = 0;
+	int i = 0;
+	
+	if (part->use_prefix) {
+		part->model = md3_read_model(part->file, NULL, 1);
+		if (!part->model)
+			return;
+		
+		for (surface = 0; surface < part->model->num_surfaces; ++surface) {
+			sptr = &part->model->surfaces[surface];
+			for (i = 0; (i < sptr->num_shaders) && (part->num_textures < MD3_PLAN_MAX_PART_TEXTURES); ++i) {
+				tex = &part->textures[part->num_textures];
+				str_to_lower(sptr->shader[i].name);
+				sprintf(tex->file, "%s%s", part->texture_path_prefix, sptr->shader[i].name);
+				format_path_for_os(tex->file);
+				
+				/* read by md3_plan_queue_second_round() */
+				if (!md3_plan_texture(NULL, part, tex->file))
+					++part->num_textures;
+			}
+		}
+		return;
+	}
+	
+	part->model = md3_read_model(part->file, plan->mod_file, 0);
+	if (!part->model || part->model->skinned || (part->model->num_surfaces > MD3_MAX_SURFACES))
+		return;
+	
+	for (surface = 0; surface < part->model->num_surfaces; ++surface)
+		textures[surface] = md3_plan_surface_texture(plan, part, surface);
+	
+	md3_cook_model(part->model, part->file, plan->mod_file, textures);
+}
+
+
+/*
+ *	Get the file of the texture a part's surface is drawn
+ *	with, either from the cook or what the skin gives it
+ *	(the last one wins).
+ *
+ *	Returns NULL if the surface has no texture.
+ */
+static char* md3_plan_surface_texture(struct md3_load_plan_t* plan, struct md3_plan_part_t* part, int surface) {
+	struct md3_plan_skin_t* skin = NULL;
+	char* file = NULL;
+	
+	if (part->model->skinned)
+		return md3_cooked_texture(part->model, surface, 0);
+	
+	for (skin = plan->skins; skin < (plan->skins + plan->num_skins); ++skin) {
+		if ((skin->part == (part - plan->parts)) && !strcmp(skin->surface, part->model->surfaces[surface].name))
+			file = plan->textures[skin->texture].file;
+	}
+	
+	return file;
+}
+
+
+/*
+ *	Job - read a texture named by the .mod file or within an MD3.
+ */
+static void md3_plan_texture_job(void* arg) {
+	struct md3_plan_texture_t* tex = (struct md3_plan_texture_t*)arg;
+	tex->tga = load_tga(tex->file);
+}
+
+
+/*
+ *	Queue the jobs that need what the first jobs read.
+ *
+ *	The textures named within the MD3 of each part that uses them
+ *	are read once those MD3s have been read.  Like the textures of
+ *	the .mod file, those the world already has are not read.
+ *	Called from the GUI thread since it looks in the world.
+ *
+ *	With USE_TEXTURE_ATLAS the character's atlas is built too.
+ *
+ *	Returns the number of jobs queued.
+ */
+static int md3_plan_queue_second_round(struct md3_load_plan_t* plan) {
+	struct md3_plan_part_t* part = NULL;
+	struct md3_plan_texture_t* tex = NULL;
+	int queued = 0;
+	
+	if (plan->second_round)
+		return 0;
+	plan->second_round = 1;
+	
+	for (part = plan->parts; part < (plan->parts + plan->num_parts); ++part) {
+		for (tex = part->textures; tex < (part->textures + part->num_textures); ++tex) {
+			tex->cached = (world_texture_cached(g_world, tex->file, NULL) != NULL);
+			if (!tex->cached) {
+				thread_pool_add(plan->pool, &plan->group, md3_plan_texture_job, tex);
+				++plan->jobs;
+				++queued;
+			}
+		}
+	}
+	
+	#ifdef USE_TEXTURE_ATLAS
+		if (plan->mod_file[0]) {
+			thread_pool_add(plan->pool, &plan->group, md3_plan_atlas_job, plan);
+			++plan->jobs;
+			++queued;
+		}
+	#endif
+	
+	return queued;
 }
+
+
+#ifdef USE_TEXTURE_ATLAS
+/*
+ *	Job - pack the textures of the parts of the .mod file into one
+ *	atlas (see atlas.h), which md3_plan_finish() hands to the world.
+ *
+ *	The atlas is made from the pixels in the TGA files, not from
+ *	the compressed textures, so it is only compressed once.  The
+ *	textures the plan did not read (the world already had them or
+ *	a cook named them differently) or read compressed are read
+ *	again for their pixels.
+ */
+static void md3_plan_atlas_job(void* arg) {
+	struct md3_load_plan_t* plan = (struct md3_load_plan_t*)arg;
+	struct md3_model_t* models[MD3_PLAN_MAX_PARTS];
+	struct tga_t* textures[MD3_PLAN_MAX_PARTS * MD3_MAX_SURFACES];
+	struct tga_t* reread[MD3_PLAN_MAX_TEXTURES];
+	char* reread_file[MD3_PLAN_MAX_TEXTURES];
+	struct md3_plan_part_t* part = NULL;
+	struct tga_t** tga = NULL;
+	char* file = NULL;
+	int num_reread = 0;
+	int num_models = 0;
+	int surface = 0;
+	int i = 0;
 	
+	for (part = plan->parts; part < (plan->parts + plan->num_parts); ++part) {
+		if (!part->model || part->use_prefix || (part->model->num_surfaces > MD3_MAX_SURFACES))
+			continue;
+		
+		for (surface = 0; surface < part->model->num_surfaces; ++surface) {
+			tga = &textures[(num_models * MD3_MAX_SURFACES) + surface];
+			*tga = NULL;
+			
+			file = md3_plan_surface_texture(plan, part, surface);
+			if (!file)
+				continue;
+			
+			for (i = 0; i < plan->num_textures; ++i) {
+				if (!strcmp(plan->textures[i].file, file))
+					break;
+			}
+			if ((i < plan->num_textures) && !plan->textures[i].cached &&
+				plan->textures[i].tga && !plan->textures[i].tga->compressed)
+			{
+				*tga = plan->textures[i].tga;
+				continue;
+			}
+			
+			for (i = 0; (i < num_reread) && strcmp(reread_file[i], file); ++i)
+				;
+			if ((i == num_reread) && (num_reread < MD3_PLAN_MAX_TEXTURES)) {
+				reread_file[num_reread] = file;
+				reread[num_reread++] = load_tga_uncompressed(file);
+			}
+			if (i < num_reread)
+				*tga = reread[i];
+		}
+		models[num_models++] = part->model;
+	}
+	
+	plan->atlas = (struct atlas_t*)malloc(sizeof(struct atlas_t));
+	if (plan->atlas && !atlas_build(plan->atlas, models, textures, num_models)) {
+		atlas_free(plan->atlas);
+		plan->atlas = NULL;
+	}
 	
+	for (i = 0; i < num_reread; ++i)
+		free_tga(reread[i]);
+}
+#endif
+
+
+/*
+ *	Job - read the animation config.
+ */
+static void md3_plan_anim_job(void* arg) {
+	struct md3_load_plan_t* plan = (struct md3_load_plan_t*)arg;
+	plan->num_anims = load_anim_file(plan->anim_file, plan->anims);
+}
+
+
 /*
  *	Link the child to the parent.
  *
@@ -720,44 +1550,17 @@ static int load_anim_file(char* file, struct md3_anim_t* aptr) {
 /*
  *	Load a texture for a specific surface for the given model.
  */
-static void load_texture_for_model(struct md3_model_t* model, char* texture, char* surface) {
-	struct md3_surface_t* sptr = model->surface_ptr;
-	while (sptr) {
+static void load_texture_for_model(struct md3_model_t* model, char* texture, char* surface, struct tga_t** decoded) {
+	struct md3_surface_t* sptr = NULL;
+	int i = 0;
+	
+	for (; i < model->num_surfaces; ++i) {
+		sptr = &model->surfaces[i];
 		if (!strcmp(sptr->name, surface)) {
 			/* this is the surface - load the texture here */
-			sptr->shader[0].texture = world_texture_cached(g_world, texture, &sptr->shader[0]);
-			
-			if (!sptr->shader[0].texture) {
-				/* if texture not already cached, load it */
-				format_path_for_os(texture);
-				sptr->shader[0].texture = load_tga(texture);
-								
-				if (sptr->shader[0].texture) {
-					/* register it with the world */
-					world_add_texture(g_world, sptr->shader[0].texture, texture, &sptr->shader[0]);
-				
-					#ifdef MD3_DEBUG
-					printf("Texture \"%s\" loaded.\n", texture);
-					#endif
-				} else
-					printf("Error: Unable to load texture \"%s\" - not found.\n", texture);
-			} else {
-				/* tell the world we need to use this texture */
-				world_using_texture(g_world, sptr->shader[0].texture);
-								
-				/* if the texture id is not -1 then it has already been bound in GL */
-				
-				#ifdef MD3_DEBUG
-				printf("Texture \"%s\" loaded (cached).\n", texture);
-				#endif
-			}
-
-			if (!sptr->shader[0].texture)
-				printf("Error: Unable to load texture \"%s\".\n", texture);
-
+			md3_load_texture(&sptr->shader[0], texture, decoded);
 			return;
 		}
-		sptr = sptr->next;
 	}
 	printf("Error: Failed to load texture \"%s\" to model %s surface %s.\n", texture, model->model_name, surface);
 }
@@ -802,7 +1605,7 @@ void load_light_model(char* file, int light_num) {
 	m->body_part = MD3_LIGHT;
 	
 	sprintf(buf, "Light %i", light_num);
-	m->model_name = strdup(buf);
+	strcpy(m->model_name, buf);
 	
 	/* manually kill tags so no links are possible */
 	m->num_tags = 0;
@@ -0,0 +1,624 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	Vertex buffer objects.
+ *
+ *	See md3_vbo.h.
+ */
+
+/* OpenGL 1.5 and 2.0 are only declared with this */
+#define GL_GLEXT_PROTOTYPES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "definitions.h"
+#include "md3_parse.h"
+#include "md3_frame_cache.h"
+#include "md3_decode.h"
+#include "md3_vbo.h"
+
+#ifdef _WIN32
+	/* opengl32.dll stops at OpenGL 1.1 */
+	typedef void (APIENTRY *md3_gen_buffers_t)(GLsizei n, GLuint* buffers);
+	typedef void (APIENTRY *md3_delete_buffers_t)(GLsizei n, const GLuint* buffers);
+	typedef void (APIENTRY *md3_bind_buffer_t)(GLenum target, GLuint buffer);
+	typedef void (APIENTRY *md3_buffer_data_t)(GLenum target, ptrdiff_t size, const GLvoid* data, GLenum usage);
+	typedef GLvoid* (APIENTRY *md3_map_buffer_t)(GLenum target, GLenum access);
+	typedef GLboolean (APIENTRY *md3_unmap_buffer_t)(GLenum target);
+	
+	static md3_gen_buffers_t glGenBuffers = NULL;
+	static md3_delete_buffers_t glDeleteBuffers = NULL;
+	static md3_bind_buffer_t glBindBuffer = NULL;
+	static md3_buffer_data_t glBufferData = NULL;
+	static md3_map_buffer_t glMapBuffer = NULL;
+	static md3_unmap_buffer_t glUnmapBuffer = NULL;
+	
+	/* or shaders */
+	typedef GLuint (APIENTRY *md3_create_shader_t)(GLenum type);
+	typedef void (APIENTRY *md3_shader_source_t)(GLuint shader, GLsizei count, const char** string, const GLint* length);
+	typedef void (APIENTRY *md3_compile_shader_t)(GLuint shader);
+	typedef void (APIENTRY *md3_get_shaderiv_t)(GLuint shader, GLenum pname, GLint* params);
+	typedef void (APIENTRY *md3_get_shader_info_log_t)(GLuint shader, GLsizei size, GLsizei* length, char* log);
+	typedef void (APIENTRY *md3_delete_shader_t)(GLuint shader);
+	typedef GLuint (APIENTRY *md3_create_program_t)(void);
+	typedef void (APIENTRY *md3_attach_shader_t)(GLuint program, GLuint shader);
+	typedef void (APIENTRY *md3_bind_attrib_location_t)(GLuint program, GLuint index, const char* name);
+	typedef void (APIENTRY *md3_link_program_t)(GLuint program);
+	typedef void (APIENTRY *md3_get_programiv_t)(GLuint program, GLenum pname, GLint* params);
+	typedef void (APIENTRY *md3_get_program_info_log_t)(GLuint program, GLsizei size, GLsizei* length, char* log);
+	typedef void (APIENTRY *md3_delete_program_t)(GLuint program);
+	typedef void (APIENTRY *md3_use_program_t)(GLuint program);
+	typedef GLint (APIENTRY *md3_get_uniform_location_t)(GLuint program, const char* name);
+	typedef void (APIENTRY *md3_uniform1f_t)(GLint location, GLfloat v0);
+	typedef void (APIENTRY *md3_uniform1i_t)(GLint location, GLint v0);
+	typedef void (APIENTRY *md3_vertex_attrib_array_t)(GLuint index);
+	typedef void (APIENTRY *md3_vertex_attrib_pointer_t)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* pointer);
+	
+	static md3_create_shader_t glCreateShader = NULL;
+	static md3_shader_source_t glShaderSource = NULL;
+	static md3_compile_shader_t glCompileShader = NULL;
+	static md3_get_shaderiv_t glGetShaderiv = NULL;
+	static md3_get_shader_info_log_t glGetShaderInfoLog = NULL;
+	static md3_delete_shader_t glDeleteShader = NULL;
+	static md3_create_program_t glCreateProgram = NULL;
+	static md3_attach_shader_t glAttachShader = NULL;
+	static md3_bind_attrib_location_t glBindAttribLocation = NULL;
+	static md3_link_program_t glLinkProgram = NULL;
+	static md3_get_programiv_t glGetProgramiv = NULL;
+	static md3_get_program_info_log_t glGetProgramInfoLog = NULL;
+	static md3_delete_program_t glDeleteProgram = NULL;
+	static md3_use_program_t glUseProgram = NULL;
+	static md3_get_uniform_location_t glGetUniformLocation = NULL;
+	static md3_uniform1f_t glUniform1f = NULL;
+	static md3_uniform1i_t glUniform1i = NULL;
+	static md3_vertex_attrib_array_t glEnableVertexAttribArray = NULL;
+	static md3_vertex_attrib_array_t glDisableVertexAttribArray = NULL;
+	static md3_vertex_attrib_pointer_t glVertexAttribPointer = NULL;
+#endif
+
+/*
+ *	Bytes of one vertex in md3_surface_vbo_t.gl_verts.
+ */
+#define MD3_VBO_VERTEX_SIZE		(sizeof(float) * 6)
+
+/*
+ *	Vertex attributes of the interpolating shader.
+ *	XYZ1 has to be 0, it stands in for glVertex().
+ */
+#define MD3_VBO_ATTRIB_XYZ1			0
+#define MD3_VBO_ATTRIB_XYZ2			1
+#define MD3_VBO_ATTRIB_NORMAL1		2
+#define MD3_VBO_ATTRIB_NORMAL2		3
+
+/*
+ *	The interpolating vertex shader (GLSL 1.10 so any OpenGL 2.0
+ *	will do, Mesa's software renderer included).
+ *
+ *	The coordinates arrive as the shorts in the MD3 file and are
+ *	scaled by MD3_XYZ_SCALE, the normals as the encoded lat/lng
+ *	short (see md3_decode_init()).  Both frames are decoded and
+ *	blended by t the same way md3_lerp_quantized() does.
+ *
+ *	Everything after that is what the fixed function pipeline
+ *	would do with the result; GL_LIGHT0 on the front material
+ *	with a non-local viewer, GL_NORMALIZE, and the user clip
+ *	planes used by the mirrors.  Fragments are left to the
+ *	fixed function pipeline (texturing, blending).
+ */
+static const char* lerp_shader =
+	"uniform float t;\n"
+	"uniform bool lighting;\n"
+	"attribute vec3 xyz1;\n"
+	"attribute vec3 xyz2;\n"
+	"attribute float normal1;\n"
+	"attribute float normal2;\n"
+	"\n"
+	"vec3 decode_normal(float n) {\n"
+	"	float lat = floor(n / 256.0);\n"
+	"	float lng = (n - (lat * 256.0));\n"
+	"	lat *= (3.14159265 / 128.0);\n"
+	"	lng *= (3.14159265 / 128.0);\n"
+	"	return vec3((cos(lat) * sin(lng)), (sin(lat) * sin(lng)), cos(lng));\n"
+	"}\n"
+	"\n"
+	"void main() {\n"
+	"	vec4 xyz = vec4(((xyz1 + (t * (xyz2 - xyz1))) * (1.0 / 64.0)), 1.0);\n"
+	"	vec3 n1 = decode_normal(normal1);\n"
+	"	vec3 n = normalize(gl_NormalMatrix * (n1 + (t * (decode_normal(normal2) - n1))));\n"
+	"	vec4 eye = (gl_ModelViewMatrix * xyz);\n"
+	"	vec4 color = gl_Color;\n"
+	"\n"
+	"	if (lighting) {\n"
+	"		vec3 l = gl_LightSource[0].position.xyz;\n"
+	"		float att = 1.0;\n"
+	"		float n_dot_l;\n"
+	"\n"
+	"		if (gl_LightSource[0].position.w != 0.0) {\n"
+	"			float d;\n"
+	"			l -= eye.xyz;\n"
+	"			d = length(l);\n"
+	"			att = (1.0 / (gl_LightSource[0].constantAttenuation + (gl_LightSource[0].linearAttenuation * d) + (gl_LightSource[0].quadraticAttenuation * d * d)));\n"
+	"		}\n"
+	"		l = normalize(l);\n"
+	"\n"
+	"		if (gl_LightSource[0].spotCutoff != 180.0) {\n"
+	"			float spot = dot(-l, normalize(gl_LightSource[0].spotDirection));\n"
+	"			att *= ((spot >= gl_LightSource[0].spotCosCutoff) ? pow(max(spot, 0.0), gl_LightSource[0].spotExponent) : 0.0);\n"
+	"		}\n"
+	"\n"
+	"		n_dot_l = dot(n, l);\n"
+	"		color = gl_FrontLightProduct[0].ambient;\n"
+	"		if (n_dot_l > 0.0) {\n"
+	"			color += (n_dot_l * gl_FrontLightProduct[0].diffuse);\n"
+	"			color += (pow(max(dot(n, normalize(l + vec3(0.0, 0.0, 1.0))), 0.0), gl_FrontMaterial.shininess) * gl_FrontLightProduct[0].specular);\n"
+	"		}\n"
+	"		color = (gl_FrontLightModelProduct.sceneColor + (att * color));\n"
+	"		color.a = gl_FrontMaterial.diffuse.a;\n"
+	"	}\n"
+	"\n"
+	"	gl_FrontColor = clamp(color, 0.0, 1.0);\n"
+	"	gl_TexCoord[0] = (gl_TextureMatrix[0] * gl_MultiTexCoord0);\n"
+	"	gl_ClipVertex = eye;\n"
+	"	gl_Position = (gl_ModelViewProjectionMatrix * xyz);\n"
+	"}\n";
+
+static int has_vbo = -1;				/* -1 = not checked yet				*/
+static int has_shaders = -1;			/* -1 = not checked yet				*/
+static unsigned int vbo_context = 0;	/* times the GL context was lost	*/
+
+static GLuint lerp_program = 0;
+static GLint lerp_t = -1;
+static GLint lerp_lighting = -1;
+
+static int md3_vbo_create(struct md3_surface_t* sptr);
+static int md3_vbo_pose(struct md3_surface_t* sptr, int frame, int next_frame, float t);
+static int md3_vbo_create_frames(struct md3_surface_t* sptr);
+static GLuint md3_vbo_compile(const char* source);
+
+
+/*
+ *	Check if OpenGL has vertex buffer objects.
+ */
+int md3_vbo_supported() {
+	const char* extensions = NULL;
+	
+	if (has_vbo != -1)
+		return has_vbo;
+	
+	extensions = (const char*)glGetString(GL_EXTENSIONS);
+	has_vbo = (extensions && strstr(extensions, "GL_ARB_vertex_buffer_object"));
+	
+	#ifdef _WIN32
+		if (has_vbo) {
+			glGenBuffers = (md3_gen_buffers_t)wglGetProcAddress("glGenBuffersARB");
+			glDeleteBuffers = (md3_delete_buffers_t)wglGetProcAddress("glDeleteBuffersARB");
+			glBindBuffer = (md3_bind_buffer_t)wglGetProcAddress("glBindBufferARB");
+			glBufferData = (md3_buffer_data_t)wglGetProcAddress("glBufferDataARB");
+			glMapBuffer = (md3_map_buffer_t)wglGetProcAddress("glMapBufferARB");
+			glUnmapBuffer = (md3_unmap_buffer_t)wglGetProcAddress("glUnmapBufferARB");
+		}
+		has_vbo = (glGenBuffers && glDeleteBuffers && glBindBuffer && glBufferData && glMapBuffer && glUnmapBuffer);
+	#endif
+	
+	#ifdef _DEBUG
+	printf("Surfaces are drawn %s.\n", (has_vbo ? "from vertex buffer objects" : "in immediate mode"));
+	#endif
+	
+	return has_vbo;
+}
+
+
+/*
+ *	Check if OpenGL has shaders (and vertex buffer objects)
+ *	and build the interpolating shader.
+ */
+int md3_vbo_shaders_supported() {
+	const char* version = NULL;
+	GLuint shader = 0;
+	GLint status = 0;
+	char log[1024];
+	
+	if (has_shaders != -1)
+		return has_shaders;
+	has_shaders = 0;
+	
+	if (!md3_vbo_supported())
+		return 0;
+	
+	/* "major.minor[.release] vendor stuff" */
+	version = (const char*)glGetString(GL_VERSION);
+	if (!version || (atoi(version) < 2))
+		return 0;
+	
+	#ifdef _WIN32
+		glCreateShader = (md3_create_shader_t)wglGetProcAddress("glCreateShader");
+		glShaderSource = (md3_shader_source_t)wglGetProcAddress("glShaderSource");
+		glCompileShader = (md3_compile_shader_t)wglGetProcAddress("glCompileShader");
+		glGetShaderiv = (md3_get_shaderiv_t)wglGetProcAddress("glGetShaderiv");
+		glGetShaderInfoLog = (md3_get_shader_info_log_t)wglGetProcAddress("glGetShaderInfoLog");
+		glDeleteShader = (md3_delete_shader_t)wglGetProcAddress("glDeleteShader");
+		glCreateProgram = (md3_create_program_t)wglGetProcAddress("glCreateProgram");
+		glAttachShader = (md3_attach_shader_t)wglGetProcAddress("glAttachShader");
+		glBindAttribLocation = (md3_bind_attrib_location_t)wglGetProcAddress("glBindAttribLocation");
+		glLinkProgram = (md3_link_program_t)wglGetProcAddress("glLinkProgram");
+		glGetProgramiv = (md3_get_programiv_t)wglGetProcAddress("glGetProgramiv");
+		glGetProgramInfoLog = (md3_get_program_info_log_t)wglGetProcAddress("glGetProgramInfoLog");
+		glDeleteProgram = (md3_delete_program_t)wglGetProcAddress("glDeleteProgram");
+		glUseProgram = (md3_use_program_t)wglGetProcAddress("glUseProgram");
+		glGetUniformLocation = (md3_get_uniform_location_t)wglGetProcAddress("glGetUniformLocation");
+		glUniform1f = (md3_uniform1f_t)wglGetProcAddress("glUniform1f");
+		glUniform1i = (md3_uniform1i_t)wglGetProcAddress("glUniform1i");
+		glEnableVertexAttribArray = (md3_vertex_attrib_array_t)wglGetProcAddress("glEnableVertexAttribArray");
+		glDisableVertexAttribArray = (md3_vertex_attrib_array_t)wglGetProcAddress("glDisableVertexAttribArray");
+		glVertexAttribPointer = (md3_vertex_attrib_pointer_t)wglGetProcAddress("glVertexAttribPointer");
+		
+		if (!glCreateShader || !glShaderSource || !glCompileShader || !glGetShaderiv || !glGetShaderInfoLog ||
+			!glDeleteShader || !glCreateProgram || !glAttachShader || !glBindAttribLocation || !glLinkProgram ||
+			!glGetProgramiv || !glGetProgramInfoLog || !glDeleteProgram || !glUseProgram || !glGetUniformLocation ||
+			!glUniform1f || !glUniform1i || !glEnableVertexAttribArray || !glDisableVertexAttribArray || !glVertexAttribPointer)
+			return 0;
+	#endif
+	
+	shader = md3_vbo_compile(lerp_shader);
+	if (!shader)
+		return 0;
+	
+	lerp_program = glCreateProgram();
+	glAttachShader(lerp_program, shader);
+	glBindAttribLocation(lerp_program, MD3_VBO_ATTRIB_XYZ1, "xyz1");
+	glBindAttribLocation(lerp_program, MD3_VBO_ATTRIB_XYZ2, "xyz2");
+	glBindAttribLocation(lerp_program, MD3_VBO_ATTRIB_NORMAL1, "normal1");
+	glBindAttribLocation(lerp_program, MD3_VBO_ATTRIB_NORMAL2, "normal2");
+	glLinkProgram(lerp_program);
+	
+	/* the program keeps it */
+	glDeleteShader(shader);
+	
+	glGetProgramiv(lerp_program, GL_LINK_STATUS, &status);
+	if (!status) {
+		glGetProgramInfoLog(lerp_program, sizeof(log), NULL, log);
+		printf("ERROR: Could not link the interpolation shader:\n%s\n", log);
+		glDeleteProgram(lerp_program);
+		lerp_program = 0;
+		return 0;
+	}
+	
+	lerp_t = glGetUniformLocation(lerp_program, "t");
+	lerp_lighting = glGetUniformLocation(lerp_program, "lighting");
+	
+	#ifdef _DEBUG
+	printf("Surfaces can be interpolated by a vertex shader.\n");
+	#endif
+	
+	has_shaders = 1;
+	return 1;
+}
+
+
+/*
+ *	Draw a surface in the given pose (frame and next_frame
+ *	interpolated by t) from its vertex buffer objects.
+ *
+ *	serial is the md3_pose_t.serial of the model's pose, the
+ *	verticies are only interpolated again when it changes.
+ *
+ *	Returns 0 if it could not be drawn this way,
+ *	it has to be drawn in immediate mode instead.
+ */
+int md3_vbo_draw(struct md3_surface_t* sptr, int frame, int next_frame, float t, unsigned int serial, int textured) {
+	struct md3_surface_vbo_t* vbo = NULL;
+	
+	if (!md3_vbo_supported() || !sptr->num_triangles)
+		return 0;
+	
+	if ((!sptr->vbo || (sptr->vbo->context != vbo_context)) && !md3_vbo_create(sptr))
+		return 0;
+	vbo = sptr->vbo;
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vbo->gl_verts);
+	
+	if (!serial || (vbo->posed_serial != serial)) {
+		vbo->posed_serial = 0;
+		if (!md3_vbo_pose(sptr, frame, next_frame, t)) {
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return 0;
+		}
+		vbo->posed_serial = serial;
+	}
+	
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, (GLvoid*)0);
+	glNormalPointer(GL_FLOAT, 0, (GLvoid*)(sizeof(float) * 3 * sptr->num_verts));
+	
+	if (textured) {
+		glBindBuffer(GL_ARRAY_BUFFER, vbo->gl_st);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, 0, (GLvoid*)0);
+	}
+	
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo->gl_indices);
+	glDrawElements(GL_TRIANGLES, (sptr->num_triangles * 3), GL_UNSIGNED_SHORT, (GLvoid*)0);
+	
+	/* leave things as immediate mode expects them */
+	if (textured)
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	return 1;
+}
+
+
+/*
+ *	Draw a surface in the given pose (frame and next_frame
+ *	interpolated by t), interpolating in the vertex shader.
+ *
+ *	Optimization.
+ *	Every frame is already in the surface's buffers, so a new
+ *	pose costs nothing but pointing the shader's two sets of
+ *	attributes at the frames and setting t.
+ *
+ *	Returns 0 if it could not be drawn this way, it has to
+ *	be drawn with md3_vbo_draw() or in immediate mode instead.
+ */
+int md3_vbo_draw_gpu(struct md3_surface_t* sptr, int frame, int next_frame, float t, int textured) {
+	struct md3_surface_vbo_t* vbo = NULL;
+	
+	if (!md3_vbo_shaders_supported() || !sptr->num_triangles)
+		return 0;
+	
+	if ((!sptr->vbo || (sptr->vbo->context != vbo_context)) && !md3_vbo_create(sptr))
+		return 0;
+	vbo = sptr->vbo;
+	
+	if (!vbo->gl_frame_xyz && !md3_vbo_create_frames(sptr))
+		return 0;
+	
+	glUseProgram(lerp_program);
+	glUniform1f(lerp_t, t);
+	glUniform1i(lerp_lighting, glIsEnabled(GL_LIGHTING));
+	
+	glEnableVertexAttribArray(MD3_VBO_ATTRIB_XYZ1);
+	glEnableVertexAttribArray(MD3_VBO_ATTRIB_XYZ2);
+	glEnableVertexAttribArray(MD3_VBO_ATTRIB_NORMAL1);
+	glEnableVertexAttribArray(MD3_VBO_ATTRIB_NORMAL2);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vbo->gl_frame_xyz);
+	glVertexAttribPointer(MD3_VBO_ATTRIB_XYZ1, 3, GL_SHORT, GL_FALSE, 0, (GLvoid*)(sizeof(short) * 3 * sptr->num_verts * frame));
+	glVertexAttribPointer(MD3_VBO_ATTRIB_XYZ2, 3, GL_SHORT, GL_FALSE, 0, (GLvoid*)(sizeof(short) * 3 * sptr->num_verts * next_frame));
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vbo->gl_frame_normals);
+	glVertexAttribPointer(MD3_VBO_ATTRIB_NORMAL1, 1, GL_UNSIGNED_SHORT, GL_FALSE, 0, (GLvoid*)(sizeof(unsigned short) * sptr->num_verts * frame));
+	glVertexAttribPointer(MD3_VBO_ATTRIB_NORMAL2, 1, GL_UNSIGNED_SHORT, GL_FALSE, 0, (GLvoid*)(sizeof(unsigned short) * sptr->num_verts * next_frame));
+	
+	if (textured) {
+		glBindBuffer(GL_ARRAY_BUFFER, vbo->gl_st);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, 0, (GLvoid*)0);
+	}
+	
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo->gl_indices);
+	glDrawElements(GL_TRIANGLES, (sptr->num_triangles * 3), GL_UNSIGNED_SHORT, (GLvoid*)0);
+	
+	/* leave things as immediate mode expects them */
+	if (textured)
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableVertexAttribArray(MD3_VBO_ATTRIB_NORMAL2);
+	glDisableVertexAttribArray(MD3_VBO_ATTRIB_NORMAL1);
+	glDisableVertexAttribArray(MD3_VBO_ATTRIB_XYZ2);
+	glDisableVertexAttribArray(MD3_VBO_ATTRIB_XYZ1);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glUseProgram(0);
+	
+	return 1;
+}
+
+
+/*
+ *	Delete the vertex buffer objects of a surface.
+ */
+void md3_vbo_drop(struct md3_surface_t* sptr) {
+	struct md3_surface_vbo_t* vbo = sptr->vbo;
+	
+	if (!vbo)
+		return;
+	
+	/* the buffers of a lost context went with it */
+	if (vbo->context == vbo_context) {
+		glDeleteBuffers(1, &vbo->gl_indices);
+		glDeleteBuffers(1, &vbo->gl_st);
+		glDeleteBuffers(1, &vbo->gl_verts);
+		if (vbo->gl_frame_xyz) {
+			glDeleteBuffers(1, &vbo->gl_frame_xyz);
+			glDeleteBuffers(1, &vbo->gl_frame_normals);
+		}
+	}
+	
+	free(vbo);
+	sptr->vbo = NULL;
+}
+
+
+/*
+ *	Forget every vertex buffer object, ie: because the GL
+ *	context was lost.  Surfaces make new ones when they
+ *	are next drawn.
+ */
+void md3_vbo_lost() {
+	++vbo_context;
+	has_vbo = -1;
+	has_shaders = -1;
+	lerp_program = 0;
+}
+
+
+/*
+ *	Make the buffers of a surface and fill
+ *	in the triangles and texture coordinates.
+ *
+ *	Returns 0 on failure.
+ */
+static int md3_vbo_create(struct md3_surface_t* sptr) {
+	struct md3_surface_vbo_t* vbo = sptr->vbo;
+	unsigned short* indices = NULL;
+	int i = 0;
+	
+	/* the indices are uploaded as shorts */
+	if (sptr->num_verts > 65536)
+		return 0;
+	
+	if (!vbo) {
+		vbo = (struct md3_surface_vbo_t*)malloc(sizeof(struct md3_surface_vbo_t));
+		if (!vbo)
+			return 0;
+		sptr->vbo = vbo;
+	}
+	memset(vbo, 0, sizeof(struct md3_surface_vbo_t));
+	
+	indices = (unsigned short*)malloc(sizeof(unsigned short) * sptr->num_triangles * 3);
+	if (!indices) {
+		free(vbo);
+		sptr->vbo = NULL;
+		return 0;
+	}
+	for (i = 0; i < (sptr->num_triangles * 3); ++i)
+		indices[i] = (unsigned short)sptr->indices[i];
+	
+	vbo->context = vbo_context;
+	glGenBuffers(1, &vbo->gl_indices);
+	glGenBuffers(1, &vbo->gl_st);
+	glGenBuffers(1, &vbo->gl_verts);
+	
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo->gl_indices);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (sizeof(unsigned short) * sptr->num_triangles * 3), indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vbo->gl_st);
+	glBufferData(GL_ARRAY_BUFFER, (sizeof(float) * sptr->num_verts * 2), sptr->st, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	free(indices);
+	
+	return 1;
+}
+
+
+/*
+ *	Interpolate the verticies and normals of a surface
+ *	into its vertex buffer, which is bound.
+ *
+ *	Returns 0 on failure.
+ */
+static int md3_vbo_pose(struct md3_surface_t* sptr, int frame, int next_frame, float t) {
+#ifdef USE_QUANTIZED_VERTICES
+	short* xyz1 = (sptr->xyz + (frame * sptr->num_verts * 3));
+	short* xyz2 = (sptr->xyz + (next_frame * sptr->num_verts * 3));
+	unsigned short* normals1 = (sptr->normals + (frame * sptr->num_verts));
+	unsigned short* normals2 = (sptr->normals + (next_frame * sptr->num_verts));
+#else
+	struct md3_cached_frame_t* f1 = md3_surface_frame(sptr, frame);
+	struct md3_cached_frame_t* f2 = md3_surface_frame(sptr, next_frame);
+#endif
+	float* dst = NULL;
+	
+	#ifndef USE_QUANTIZED_VERTICES
+		/* out of memory */
+		if (!f1 || !f2)
+			return 0;
+	#endif
+	
+	/* a new buffer rather than waiting for OpenGL to finish with the old one */
+	glBufferData(GL_ARRAY_BUFFER, (MD3_VBO_VERTEX_SIZE * sptr->num_verts), NULL, GL_DYNAMIC_DRAW);
+	dst = (float*)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	if (!dst)
+		return 0;
+	
+	#ifdef USE_QUANTIZED_VERTICES
+		md3_lerp_quantized(xyz1, normals1, xyz2, normals2, sptr->num_verts, t, dst, (dst + (sptr->num_verts * 3)));
+	#else
+		md3_lerp_vertices(f1->xyz, f1->normals, f2->xyz, f2->normals, sptr->num_verts, t, dst, (dst + (sptr->num_verts * 3)));
+	#endif
+	
+	/* the buffer can be lost while mapped (ie: a mode change) */
+	return (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE);
+}
+
+
+/*
+ *	Make the buffers holding every frame of a surface
+ *	for md3_vbo_draw_gpu().
+ *
+ *	Returns 0 on failure.
+ */
+static int md3_vbo_create_frames(struct md3_surface_t* sptr) {
+	struct md3_surface_vbo_t* vbo = sptr->vbo;
+	
+	glGenBuffers(1, &vbo->gl_frame_xyz);
+	glGenBuffers(1, &vbo->gl_frame_normals);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vbo->gl_frame_xyz);
+	glBufferData(GL_ARRAY_BUFFER, (sizeof(short) * 3 * sptr->num_verts * sptr->num_frames), sptr->xyz, GL_STATIC_DRAW);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vbo->gl_frame_normals);
+	glBufferData(GL_ARRAY_BUFFER, (sizeof(unsigned short) * sptr->num_verts * sptr->num_frames), sptr->normals, GL_STATIC_DRAW);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	/* out of (video) memory */
+	if (glGetError() == GL_OUT_OF_MEMORY) {
+		glDeleteBuffers(1, &vbo->gl_frame_xyz);
+		glDeleteBuffers(1, &vbo->gl_frame_normals);
+		vbo->gl_frame_xyz = 0;
+		vbo->gl_frame_normals = 0;
+		return 0;
+	}
+	
+	return 1;
+}
+
+
+/*
+ *	Compile a vertex shader.
+ *
+ *	Returns 0 on failure.
+ */
+static GLuint md3_vbo_compile(const char* source) {
+	GLuint shader = glCreateShader(GL_VERTEX_SHADER);
+	GLint status = 0;
+	char log[1024];
+	
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("ERROR: Could not compile the interpolation shader:\n%s\n", log);
+		glDeleteShader(shader);
+		return 0;
+	}
+	
+	return shader;
+}
@@ -0,0 +1,243 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	Mipmap generation.
+ *
+ *	Each level is a 2x2 box filter of the one above it.
+ *	Averaging sRGB encoded colors directly darkens every level,
+ *	so colors are converted to linear light (MIPMAP_LINEAR_BITS
+ *	bits per channel) through a lookup table, filtered, and
+ *	converted back.  Alpha is already linear.
+ *
+ *	Optimization.
+ *
+ *	The linear image always has 4 channels of 16 bits so the
+ *	filter does not care about the texture format and two
+ *	output pixels are made at a time with SSE2.
+ */
+
+#include <stdio.h>
+#include <malloc.h>
+#include <string.h>
+#include <math.h>
+#include "definitions.h"
+#include "tga.h"
+#include "mipmap.h"
+
+#ifdef USE_SSE2
+	#include <emmintrin.h>
+#endif
+
+
+static unsigned short srgb_to_linear[256];
+static unsigned short alpha_to_linear[256];
+static byte linear_to_srgb[MIPMAP_LINEAR_MAX + 1];
+static byte linear_to_alpha[MIPMAP_LINEAR_MAX + 1];
+
+static int tables_built = 0;
+
+
+static void to_linear(const byte* src, unsigned short* dst, int pixels, int depth);
+static void from_linear(const unsigned short* src, byte* dst, int pixels, int depth);
+static void downsample(const unsigned short* src, int w, int h, unsigned short* dst, int nw, int nh);
+
+
+/*
+ *	Build the conversion tables.
+ *	Safe to call more than once, but must be called
+ *	before textures are loaded on other threads.
+ */
+void mipmap_init() {
+	double c = 0.0;
+	int i = 0;
+	
+	if (tables_built)
+		return;
+	
+	for (i = 0; i < 256; ++i) {
+		c = (i / 255.0);
+		c = ((c <= 0.04045) ? (c / 12.92) : pow(((c + 0.055) / 1.055), 2.4));
+		srgb_to_linear[i] = (unsigned short)((c * MIPMAP_LINEAR_MAX) + 0.5);
+		alpha_to_linear[i] = (unsigned short)(((i * MIPMAP_LINEAR_MAX) + 127) / 255);
+	}
+	
+	for (i = 0; i <= MIPMAP_LINEAR_MAX; ++i) {
+		c = ((double)i / MIPMAP_LINEAR_MAX);
+		c = ((c <= 0.0031308) ? (c * 12.92) : ((1.055 * pow(c, (1.0 / 2.4))) - 0.055));
+		linear_to_srgb[i] = (byte)((c * 255.0) + 0.5);
+		linear_to_alpha[i] = (byte)(((i * 255) + (MIPMAP_LINEAR_MAX / 2)) / MIPMAP_LINEAR_MAX);
+	}
+	
+	tables_built = 1;
+}
+
+
+/*
+ *	Build every mipmap level of a texture below the full size image.
+ *
+ *	Returns 0 if out of memory (the texture is left without mipmaps).
+ */
+int mipmap_build(struct tga_t* tga) {
+	unsigned short* src = NULL;
+	unsigned short* dst = NULL;
+	unsigned short* tmp = NULL;
+	int w = tga->header.width;
+	int h = tga->header.height;
+	int nw = 0;
+	int nh = 0;
+	
+	mipmap_free(tga);
+	
+	if ((w <= 1) && (h <= 1))
+		return 1;
+	
+	src = (unsigned short*)malloc(sizeof(unsigned short) * 4 * w * h);
+	dst = (unsigned short*)malloc(sizeof(unsigned short) * 4 * ((w + 1) / 2) * ((h + 1) / 2));
+	if (!src || !dst) {
+		free(src);
+		free(dst);
+		return 0;
+	}
+	
+	to_linear(tga->img, src, (w * h), tga->header.depth);
+	
+	while (((w > 1) || (h > 1)) && (tga->num_mips < TGA_MAX_MIPS)) {
+		nw = ((w > 1) ? (w / 2) : 1);
+		nh = ((h > 1) ? (h / 2) : 1);
+		
+		tga->mips[tga->num_mips] = (byte*)malloc(nw * nh * tga->header.depth);
+		if (!tga->mips[tga->num_mips]) {
+			mipmap_free(tga);
+			break;
+		}
+		
+		downsample(src, w, h, dst, nw, nh);
+		from_linear(dst, tga->mips[tga->num_mips], (nw * nh), tga->header.depth);
+		++tga->num_mips;
+		
+		/* this level is the source of the next one */
+		tmp = src;
+		src = dst;
+		dst = tmp;
+		w = nw;
+		h = nh;
+	}
+	
+	free(src);
+	free(dst);
+	
+	return (tga->num_mips > 0);
+}
+
+
+/*
+ *	Free the mipmap levels of a texture.
+ */
+void mipmap_free(struct tga_t* tga) {
+	int i = 0;
+	
+	for (; i < tga->num_mips; ++i) {
+		free(tga->mips[i]);
+		tga->mips[i] = NULL;
+	}
+	tga->num_mips = 0;
+}
+
+
+/*
+ *	Convert pixels of depth bytes (luminance, BGR or BGRA)
+ *	into 4 linear channels.
+ */
+static void to_linear(const byte* src, unsigned short* dst, int pixels, int depth) {
+	int i = 0;
+	
+	for (; i < pixels; ++i, src += depth, dst += 4) {
+		dst[0] = srgb_to_linear[src[0]];
+		dst[1] = ((depth >= 3) ? srgb_to_linear[src[1]] : 0);
+		dst[2] = ((depth >= 3) ? srgb_to_linear[src[2]] : 0);
+		dst[3] = ((depth == 4) ? alpha_to_linear[src[3]] : 0);
+	}
+}
+
+
+/*
+ *	Convert 4 linear channels back into pixels of depth bytes.
+ */
+static void from_linear(const unsigned short* src, byte* dst, int pixels, int depth) {
+	int i = 0;
+	
+	for (; i < pixels; ++i, src += 4, dst += depth) {
+		dst[0] = linear_to_srgb[src[0]];
+		if (depth >= 3) {
+			dst[1] = linear_to_srgb[src[1]];
+			dst[2] = linear_to_srgb[src[2]];
+		}
+		if (depth == 4)
+			dst[3] = linear_to_alpha[src[3]];
+	}
+}
+
+
+/*
+ *	Average each 2x2 block of the w x h linear image at src into
+ *	the nw x nh image at dst.  An odd last row or column is dropped
+ *	and a dimension of 1 is averaged with itself.
+ */
+static void downsample(const unsigned short* src, int w, int h, unsigned short* dst, int nw, int nh) {
+	const unsigned short* row0 = NULL;
+	const unsigned short* row1 = NULL;
+	int p0 = 0;
+	int p1 = 0;
+	int x = 0;
+	int y = 0;
+	int c = 0;
+	
+	#ifdef USE_SSE2
+		const __m128i round = _mm_set1_epi16(2);
+		__m128i a, b;
+	#endif
+	
+	for (; y < nh; ++y) {
+		row0 = (src + ((y * 2) * w * 4));
+		row1 = ((h > 1) ? (row0 + (w * 4)) : row0);
+		x = 0;
+		
+		#ifdef USE_SSE2
+			/* each 128 bits is 2 pixels; add the rows, then the pixel pairs */
+			if (w > 1) {
+				for (; (x + 2) <= nw; x += 2, dst += 8) {
+					a = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(row0 + (x * 8))), _mm_loadu_si128((const __m128i*)(row1 + (x * 8))));
+					b = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(row0 + (x * 8) + 8)), _mm_loadu_si128((const __m128i*)(row1 + (x * 8) + 8)));
+					a = _mm_add_epi16(a, _mm_srli_si128(a, 8));
+					b = _mm_add_epi16(b, _mm_srli_si128(b, 8));
+					a = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(a, b), round), 2);
+					_mm_storeu_si128((__m128i*)dst, a);
+				}
+			}
+		#endif
+		
+		/* whatever is left over */
+		for (; x < nw; ++x, dst += 4) {
+			p0 = ((x * 2) * 4);
+			p1 = ((w > 1) ? (p0 + 4) : p0);
+			for (c = 0; c < 4; ++c)
+				dst[c] = (unsigned short)((row0[p0 + c] + row0[p1 + c] + row1[p0 + c] + row1[p1 + c] + 2) >> 2);
+		}
+	}
+}
@@ -18,6 +18,7 @@
 
 //#include <GL/glu.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include <string.h>
 #include <time.h>
@@ -25,6 +26,9 @@
 #include "definitions.h"
 #include "quaternion.h"
 #include "world.h"
+#include "md3_frame_cache.h"
+#include "md3_decode.h"
+#include "md3_vbo.h"
 #include "util.h"
 #include "jitter.h"
 #include "accum.h"
@@ -68,6 +72,25 @@ static void render_scene();
 static void render_depth_of_field();
 static void apply_custom_rotation(struct md3_model_t* model, struct md3_tag_t* tag, struct quat_t* quat);
 static void render_primitives_aa(int aa, int apply_names);
+static void pose_model(struct md3_model_t* model);
+static void pose_tag(struct md3_model_t* model, int tag, float* m);
+static float* pose_surface(struct md3_model_t* model, struct md3_surface_t* sptr);
+
+#ifdef USE_FRUSTUM_CULLING
+	/*
+	 *	The planes of the view frustum, and of the mirror clipping
+	 *	plane when it is on, in the coordinates of the model being
+	 *	drawn.  A point is inside if (a*x + b*y + c*z + d) >= 0 for
+	 *	every plane.
+	 */
+	struct frustum_t {
+		float planes[7][4];
+		int num_planes;
+	};
+	
+	static void frustum_get(struct frustum_t* f);
+	static int frustum_cull(struct frustum_t* f, struct vec3_t* min1, struct vec3_t* max1, struct vec3_t* min2, struct vec3_t* max2, float t);
+#endif
 
 /*
  *	Render the scene for the current engine setup.
@@ -253,17 +276,9 @@ void md3_render(struct md3_model_t* model, int apply_names, struct md3_tag_t* li
 	int next_frame;
 
 	struct md3_tag_t* tag = NULL;
-	struct md3_tag_t* next_tag = NULL;
 	int itag = 0;
-	float* rot1 = NULL;
-	float* rot2 = NULL;
 	float rot[16];
 	struct quat_t q1;
-	struct quat_t q2;
-	struct quat_t q3;
-	struct vec3_t* origin1 = NULL;
-	struct vec3_t* origin2 = NULL;
-	struct vec3_t origin;
 
 	if (!model)
 		return;
@@ -318,38 +333,17 @@ void md3_render(struct md3_model_t* model, int apply_names, struct md3_tag_t* li
 		 */
 		glPushMatrix();
 		
-		/* SLERP the rotation */
 		itag = (((model->anim_state.frame % model->num_frames) * model->num_tags) + i);
 		tag = &(model->tags[itag]);
-	
-		itag = (((model->anim_state.next_frame % model->num_frames) * model->num_tags) + i);
-		next_tag = &(model->tags[itag]);
-	
-		/* LERP the origin translation - needed? */
-		origin1 = &tag->origin;
-		origin2 = &next_tag->origin;
-		LERP_VERTEX(origin1, origin2, model->anim_state.t, (&origin));
 		
-		/*
-		 *	If there was a custom scale set, it must also be
-		 *	applied to the origin so that the body parts align.
-		 */
-		if (model->scale_factor)
-			SCALE_VERTEX((&origin), model->scale_factor);
-		
-		rot1 = (float*)tag->axis;
-		rot2 = (float*)next_tag->axis;
-		
-		/* convert the 3x3 matricies to quaternions */
-		quat_from_matrix_3x3(&q1, rot1);
-		quat_from_matrix_3x3(&q2, rot2);
-
-		/* slerp the quaternions */
-		quat_slerp(&q1, &q2, model->anim_state.t, &q3);
-		
-		/* convert the quaternion to 4x4 matrix and apply */
-		quat_to_matrix_4x4(&q3, &origin, rot);
-		glMultMatrixf(rot);
+		/* the tag matrices were interpolated by md3_render_single() */
+		if (model->pose.tags)
+			glMultMatrixf(model->pose.tags + (i * 16));
+		else {
+			/* out of memory, interpolate it every time */
+			pose_tag(model, i, rot);
+			glMultMatrixf(rot);
+		}
 		
 		/* Render child */
 		md3_render(model->links[i], apply_names, tag);
@@ -364,16 +358,20 @@ void md3_render(struct md3_model_t* model, int apply_names, struct md3_tag_t* li
  *	There is no SLERP here.
  */
 void md3_render_single(struct md3_model_t* model, int apply_names) {
-	struct md3_surface_t* sptr = model->surface_ptr;
-	struct md3_vertex_t* vptr1 = NULL;
-	struct md3_vertex_t* vptr2 = NULL;
-	struct md3_vertex_t vptr;
-	struct md3_texcoord_t* tptr = NULL;
-	struct tga_t* texture = NULL;
-	int frame_offset;
-	int next_frame_offset;
+	struct md3_surface_t* sptr = NULL;
+	float* xyz = NULL;
+	float* normals = NULL;
+	float* st = NULL;
+	int num_triangles;
+	int index;
 	int vertex;
+	int surface = 0;
 	int i = 0;
+#ifdef USE_FRUSTUM_CULLING
+	struct frustum_t frustum;
+	int frame = 0;
+	int next_frame = 0;
+#endif
 	
 	/* white material used for textures */
 	apply_material(&white_material);
@@ -382,23 +380,78 @@ void md3_render_single(struct md3_model_t* model, int apply_names) {
 	if (apply_names)
 		glLoadName(model->body_part);
 	
-	/* tick the model to update animation information */
-	world_tick_model(model);
+	/* interpolate the tags for this frame (if no pass has yet) */
+	pose_model(model);
 	
-	while (sptr) {
+	#ifdef USE_FRUSTUM_CULLING
+		/*
+		 *	Optimization.
+		 *	Skip the whole part if its bounds, interpolated like its
+		 *	verticies, are outside the frustum of the matrices it is
+		 *	being drawn with.  These already hold any jitter, mirroring
+		 *	or picking of this pass.
+		 */
+		frustum_get(&frustum);
+		frame = (model->anim_state.frame % model->num_frames);
+		next_frame = (model->anim_state.next_frame % model->num_frames);
+		if (frustum_cull(&frustum, &model->frames[frame].min_bounds, &model->frames[frame].max_bounds,
+						 &model->frames[next_frame].min_bounds, &model->frames[next_frame].max_bounds, model->anim_state.t))
+			return;
+	#endif
+	
+	for (; surface < model->num_surfaces; ++surface) {
+		sptr = &model->surfaces[surface];
+		num_triangles = sptr->num_triangles;
+		
+		#ifdef USE_FRUSTUM_CULLING
+			/* and each surface of it that is outside */
+			frame = (model->anim_state.frame % sptr->num_frames);
+			next_frame = (model->anim_state.next_frame % sptr->num_frames);
+			if (frustum_cull(&frustum, &sptr->bounds[frame].min_bounds, &sptr->bounds[frame].max_bounds,
+							 &sptr->bounds[next_frame].min_bounds, &sptr->bounds[next_frame].max_bounds, model->anim_state.t))
+				num_triangles = 0;
+		#endif
+		
 		/* Get texture */
-		if (WORLD_IS_SET(RENDER_TEXTURES)) {
-			texture = sptr->shader[0].texture;
+		if (WORLD_IS_SET(RENDER_TEXTURES))
 			apply_texture(&(sptr->shader[0]));
-		} else
+		else
 			glDisable(GL_TEXTURE_2D);
 		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
 		
-		/* get correct frame information */
-		frame_offset = ((model->anim_state.frame % sptr->num_frames) * sptr->num_verts);
-		next_frame_offset = ((model->anim_state.next_frame % sptr->num_frames) * sptr->num_verts);
+		#ifdef USE_VBO
+			/*
+			 *	Optimization.
+			 *	The whole surface in one call, interpolated by the vertex
+			 *	shader if asked for and there is one.  Wireframes stay in
+			 *	immediate mode since their line strips are not culled
+			 *	like polygons are.
+			 */
+			if (num_triangles && !WORLD_IS_SET(RENDER_WIREFRAME)) {
+				if (WORLD_IS_SET(ENGINE_GPU_LERP) &&
+					md3_vbo_draw_gpu(sptr, (model->anim_state.frame % sptr->num_frames), (model->anim_state.next_frame % sptr->num_frames),
+									 model->anim_state.t, (WORLD_IS_SET(RENDER_TEXTURES) && sptr->shader[0].gl_text_bound)))
+					num_triangles = 0;
+				else if (md3_vbo_draw(sptr, (model->anim_state.frame % sptr->num_frames), (model->anim_state.next_frame % sptr->num_frames),
+									  model->anim_state.t, model->pose.serial, (WORLD_IS_SET(RENDER_TEXTURES) && sptr->shader[0].gl_text_bound)))
+					num_triangles = 0;
+			}
+		#endif
+		
+		/*
+		 *	Optimization.
+		 *	LERP every vertex once up front rather than once for each
+		 *	triangle that uses it, and only for the first pass to draw
+		 *	this pose.
+		 */
+		if (num_triangles) {
+			xyz = pose_surface(model, sptr);
+			if (!xyz)
+				num_triangles = 0;
+			normals = (xyz + (sptr->num_verts * 3));
+		}
 
-		for (i = 0; i < sptr->num_triangles; ++i) {
+		for (i = 0; i < num_triangles; ++i) {
 			if (WORLD_IS_SET(RENDER_WIREFRAME))
 				glBegin(GL_LINE_STRIP);
 			else
@@ -406,27 +459,19 @@ void md3_render_single(struct md3_model_t* model, int apply_names) {
 
 			/* draw the three verticies for the triangle */
 			for (vertex = 0; vertex < 3; ++vertex) {
-				/* get texture data */
-				tptr = &(sptr->st[ sptr->triangle[i].index[vertex] ]);
+				index = sptr->indices[(i * 3) + vertex];
 				
-				/* get vertex data for this frame and next frame */
-				vptr1 = &(sptr->vertex[ sptr->triangle[i].index[vertex] + frame_offset ]);
-				vptr2 = &(sptr->vertex[ sptr->triangle[i].index[vertex] + next_frame_offset ]);
-
-				/* LERP the verticies */
-				LERP_VERTEX(vptr1, vptr2, model->anim_state.t, (&vptr));
-				
-				/* LERP the normal */
-				LERP_NORMAL(vptr1, vptr2, model->anim_state.t, (&vptr));
+				/* get texture data */
+				st = &(sptr->st[index * 2]);
 				
 				/* set the normal and texture data */
-				glNormal3f(vptr.normalxyz[0], vptr.normalxyz[1], vptr.normalxyz[2]);
+				glNormal3fv(normals + (index * 3));
 				
-				if (WORLD_IS_SET(RENDER_TEXTURES) && sptr->shader[0].gl_text_bound && tptr)
-					glTexCoord2f((texture->hflip ? (1 - tptr->st[0]) : tptr->st[0]), (texture->vflip ? (1 - tptr->st[1]) : tptr->st[1]));
+				if (WORLD_IS_SET(RENDER_TEXTURES) && sptr->shader[0].gl_text_bound)
+					glTexCoord2fv(st);
 				
-				/* draw it */
-				glVertex3f((float)(vptr.x * MD3_XYZ_SCALE), (float)(vptr.y * MD3_XYZ_SCALE), (float)(vptr.z * MD3_XYZ_SCALE));
+				/* draw it - the verticies are scaled when they are loaded */
+				glVertex3fv(xyz + (index * 3));
 			}
 			
 			glEnd();
@@ -436,7 +481,7 @@ void md3_render_single(struct md3_model_t* model, int apply_names) {
 		 *	Draw the bounding box if this model has the flag
 		 *	set and this is also the first surface for the model.
 		 */
-		if (model->draw_bounding_box && (sptr == model->surface_ptr)) {
+		if (model->draw_bounding_box && !surface) {
 			struct md3_frame_t* f = &model->frames[0];
 			float r = (f->radius / 2.5f);
 			
@@ -454,12 +499,215 @@ void md3_render_single(struct md3_model_t* model, int apply_names) {
 			if (WORLD_IS_SET(RENDER_TEXTURES))
 				glEnable(GL_TEXTURE_2D);
 		}
+	}
+}
+
+
+
+/*
+ *	Bring the pose of a model up to date with its animation state.
+ *
+ *	Interpolates every tag matrix and invalidates the verticies
+ *	interpolated by pose_surface() if the pose has changed.
+ *	Otherwise this is what an earlier pass already drew.
+ */
+static void pose_model(struct md3_model_t* model) {
+	struct md3_pose_t* pose = &model->pose;
+	int i = 0;
+	
+	if (pose->serial &&
+		(pose->frame == model->anim_state.frame) && (pose->next_frame == model->anim_state.next_frame) &&
+		(pose->t == model->anim_state.t) && (pose->scale_factor == model->scale_factor))
+		return;
+	
+	pose->frame = model->anim_state.frame;
+	pose->next_frame = model->anim_state.next_frame;
+	pose->t = model->anim_state.t;
+	pose->scale_factor = model->scale_factor;
+	
+	/* 0 is never posed */
+	if (!++pose->serial)
+		++pose->serial;
+	
+	if (!pose->tags && model->num_tags)
+		pose->tags = (float*)malloc(sizeof(float) * 16 * model->num_tags);
+	if (!pose->tags)
+		return;
+	
+	for (; i < model->num_tags; ++i)
+		pose_tag(model, i, (pose->tags + (i * 16)));
+}
+
+
+/*
+ *	Interpolate the 4x4 matrix of a tag for the
+ *	current animation state of the model.
+ */
+static void pose_tag(struct md3_model_t* model, int tag, float* m) {
+	struct md3_tag_pose_t* pose1 = NULL;
+	struct md3_tag_pose_t* pose2 = NULL;
+	struct quat_t q1;
+	struct quat_t q2;
+	struct quat_t q3;
+	struct vec3_t* origin1 = NULL;
+	struct vec3_t* origin2 = NULL;
+	struct vec3_t origin;
+	
+	pose1 = &(model->tag_poses[((model->anim_state.frame % model->num_frames) * model->num_tags) + tag]);
+	pose2 = &(model->tag_poses[((model->anim_state.next_frame % model->num_frames) * model->num_tags) + tag]);
+	
+	/* LERP the origin translation - needed? */
+	origin1 = &pose1->origin;
+	origin2 = &pose2->origin;
+	LERP_VERTEX(origin1, origin2, model->anim_state.t, (&origin));
+	
+	/*
+	 *	If there was a custom scale set, it must also be
+	 *	applied to the origin so that the body parts align.
+	 */
+	if (model->scale_factor)
+		SCALE_VERTEX((&origin), model->scale_factor);
+	
+	/*
+	 *	The tags were converted to quaternions when the model was loaded.
+	 *	Copy them since quat_slerp() may negate q2.
+	 */
+	memcpy(&q1, pose1->quat, sizeof(struct quat_t));
+	memcpy(&q2, pose2->quat, sizeof(struct quat_t));
+
+	/* slerp the quaternions */
+	quat_slerp(&q1, &q2, model->anim_state.t, &q3);
+	
+	/* convert the quaternion to 4x4 matrix */
+	quat_to_matrix_4x4(&q3, &origin, m);
+}
+
+
+/*
+ *	Get the verticies then normals of a surface interpolated
+ *	for the model's pose, interpolating them if this is the
+ *	first pass to draw this pose.
+ *
+ *	Returns NULL if out of memory.
+ */
+static float* pose_surface(struct md3_model_t* model, struct md3_surface_t* sptr) {
+	int frame = (model->anim_state.frame % sptr->num_frames);
+	int next_frame = (model->anim_state.next_frame % sptr->num_frames);
+#ifndef USE_QUANTIZED_VERTICES
+	struct md3_cached_frame_t* f1 = NULL;
+	struct md3_cached_frame_t* f2 = NULL;
+#endif
+	
+	if (sptr->posed && (sptr->posed_serial == model->pose.serial))
+		return sptr->posed;
+	
+	if (!sptr->posed) {
+		sptr->posed = (float*)malloc(sizeof(float) * 6 * sptr->num_verts);
+		if (!sptr->posed)
+			return NULL;
+	}
+	
+	#ifdef USE_QUANTIZED_VERTICES
+		md3_lerp_quantized((sptr->xyz + (frame * sptr->num_verts * 3)), (sptr->normals + (frame * sptr->num_verts)),
+						   (sptr->xyz + (next_frame * sptr->num_verts * 3)), (sptr->normals + (next_frame * sptr->num_verts)),
+						   sptr->num_verts, model->anim_state.t, sptr->posed, (sptr->posed + (sptr->num_verts * 3)));
+	#else
+		/* decoding the frames if needed */
+		f1 = md3_surface_frame(sptr, frame);
+		f2 = md3_surface_frame(sptr, next_frame);
 		
-		sptr = sptr->next;
+		/* out of memory */
+		if (!f1 || !f2)
+			return NULL;
+		
+		md3_lerp_vertices(f1->xyz, f1->normals, f2->xyz, f2->normals, sptr->num_verts, model->anim_state.t,
+						  sptr->posed, (sptr->posed + (sptr->num_verts * 3)));
+	#endif
+	
+	sptr->posed_serial = model->pose.serial;
+	return sptr->posed;
+}
+
+
+#ifdef USE_FRUSTUM_CULLING
+/*
+ *	Get the frustum of the current projection and modelview
+ *	matrices, and the mirror clipping plane if it is on, in
+ *	the coordinates of the modelview matrix.
+ *
+ *	The frustum planes are the rows of the combined matrix
+ *	(Gribb and Hartmann).  They are not normalized, they are
+ *	only used to see which side of them things are.
+ */
+static void frustum_get(struct frustum_t* f) {
+	GLfloat p[16];
+	GLfloat m[16];
+	GLfloat c[16];
+	GLdouble clip[4];
+	int i = 0;
+	int j = 0;
+	
+	glGetFloatv(GL_PROJECTION_MATRIX, p);
+	glGetFloatv(GL_MODELVIEW_MATRIX, m);
+	
+	/* c = p * m, column major like OpenGL */
+	for (i = 0; i < 4; ++i) {
+		for (j = 0; j < 4; ++j)
+			c[(j * 4) + i] = ((p[i] * m[j * 4]) + (p[4 + i] * m[(j * 4) + 1]) + (p[8 + i] * m[(j * 4) + 2]) + (p[12 + i] * m[(j * 4) + 3]));
+	}
+	
+	/* left/right, bottom/top and near/far are the w row plus and minus the x, y and z rows */
+	for (i = 0; i < 3; ++i) {
+		for (j = 0; j < 4; ++j) {
+			f->planes[i * 2][j] = (c[(j * 4) + 3] + c[(j * 4) + i]);
+			f->planes[(i * 2) + 1][j] = (c[(j * 4) + 3] - c[(j * 4) + i]);
+		}
+	}
+	f->num_planes = 6;
+	
+	/* the mirror clipping plane is kept in eye coordinates */
+	if (glIsEnabled(GL_CLIP_PLANE0)) {
+		glGetClipPlane(GL_CLIP_PLANE0, clip);
+		for (j = 0; j < 4; ++j)
+			f->planes[6][j] = (float)((clip[0] * m[j * 4]) + (clip[1] * m[(j * 4) + 1]) + (clip[2] * m[(j * 4) + 2]) + (clip[3] * m[(j * 4) + 3]));
+		f->num_planes = 7;
 	}
 }
 
 
+/*
+ *	Check if a box (min1/max1 and min2/max2 interpolated by t)
+ *	is entirely outside the frustum.
+ *
+ *	Every point of a surface interpolated between two frames
+ *	stays inside the box interpolated between their bounds.
+ *
+ *	Returns 1 if it is outside and does not need to be drawn.
+ */
+static int frustum_cull(struct frustum_t* f, struct vec3_t* min1, struct vec3_t* max1, struct vec3_t* min2, struct vec3_t* max2, float t) {
+	struct vec3_t mins;
+	struct vec3_t maxs;
+	struct vec3_t* pmins = &mins;
+	struct vec3_t* pmaxs = &maxs;
+	float* plane = NULL;
+	int i = 0;
+	
+	LERP_VERTEX(min1, min2, t, pmins);
+	LERP_VERTEX(max1, max2, t, pmaxs);
+	
+	/* test the corner of the box furthest inside each plane */
+	for (; i < f->num_planes; ++i) {
+		plane = f->planes[i];
+		if (((plane[0] * ((plane[0] > 0) ? maxs.x : mins.x)) +
+			 (plane[1] * ((plane[1] > 0) ? maxs.y : mins.y)) +
+			 (plane[2] * ((plane[2] > 0) ? maxs.z : mins.z)) + plane[3]) < 0)
+			return 1;
+	}
+	
+	return 0;
+}
+#endif
+
 
 static void apply_custom_rotation(struct md3_model_t* model, struct md3_tag_t* tag, struct quat_t* quat) {
 	struct quat_t c_local;
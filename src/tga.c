@@ -20,65 +20,283 @@
 #include <malloc.h>
 #include <string.h>
 #include "definitions.h"
+#include "util.h"
 #include "world.h"
 #include "tga.h"
+#include "mipmap.h"
+#include "tga_compress.h"
+
+
+static struct tga_t* tga_read(char* file, int uncompressed);
+static const byte* tga_decode_rle(const byte* src, const byte* end, byte* dst, size_t pixels, int bpp);
+static void tga_fill(byte* dst, const byte* pixel, int bpp, size_t bytes);
+static void tga_expand_16(const byte* src, byte* dst, size_t pixels);
+static void tga_flip(struct tga_t* tga);
+static byte* tga_expand_bgra(byte* src, size_t pixels, int depth);
+static byte* tga_pixels(struct tga_t* tga, long* len);
+
 
 /*
  *	Load a tga file.
+ *
+ *	Handles uncompressed and run-length encoded (image types 9, 10
+ *	and 11) true color, color mapped and greyscale images.
+ *	The image is flipped to be top row first and expanded to BGRA,
+ *	which every driver can upload without converting it.
+ *
+ *	Optimization.
+ *
+ *	An uncompressed BGRA image stored top row first is already
+ *	that, so rather than being copied out of the mapped file its
+ *	pixels are used right where they are and the file stays mapped
+ *	until the pixels are freed (usually once they are uploaded).
+ *
+ *	With USE_TEXTURE_COMPRESSION the texture comes back compressed,
+ *	from its cache if it has one (see tga_compress.h).
+ *
+ *	Returns NULL if the file can not be read or is corrupt.
  */
 struct tga_t* load_tga(char* file) {
+	return tga_read(file, 0);
+}
+
+
+/*
+ *	Load a tga file as only its BGRA pixels, without mipmaps
+ *	or compression, for textures made out of other textures
+ *	(see atlas.h) which are mipmapped and compressed once made.
+ *
+ *	Returns NULL if the file can not be read or is corrupt.
+ */
+struct tga_t* load_tga_uncompressed(char* file) {
+	return tga_read(file, 1);
+}
+
+
+/*
+ *	Load a tga file, see load_tga().
+ *	If uncompressed is set it is left at its BGRA pixels.
+ */
+static struct tga_t* tga_read(char* file, int uncompressed) {
 	struct tga_t* tga = NULL;
-	FILE* fptr = NULL;
-	int size = 0;
+	byte* data = NULL;
+	const byte* src = NULL;
+	const byte* end = NULL;
+	byte* pixels = NULL;
+	byte* palette = NULL;
+	long len = 0;
+	size_t count = 0;
+	size_t size = 0;
+	size_t p = 0;
+	int type = 0;
+	int bpp = 0;
+	int entry = 0;
+	int palette_bpp = 0;
+	int index = 0;
+	int i = 0;
+	int w = 0;
+	int h = 0;
+	
+	#ifdef USE_TEXTURE_COMPRESSION
+		tga = (uncompressed ? NULL : tga_load_compressed(file));
+		if (tga) {
+			tga_hash(tga);
+			return tga;
+		}
+	#endif
 	
-	fptr = fopen(file, "rb");
-	if (!fptr)
+	data = (byte*)map_file(file, &len);
+	if (!data)
 		return NULL;
+	end = (data + len);
 
 	tga = (struct tga_t*)malloc(sizeof(struct tga_t));
+	if (!tga) {
+		unmap_file(data, len);
+		return NULL;
+	}
 	memset(tga, 0, sizeof(struct tga_t));
 
 	/* read the header */
-	fread((void*)&(tga->header), 18, 1, fptr);
+	if (len < 18)
+		goto corrupt;
+	memcpy(&tga->header, data, 18);
 	
-	tga->header.depth /= 8;
-
-	/* allocate memory for the image body */
-	size = (tga->header.width * tga->header.height * tga->header.depth);
-	tga->img = (byte*)malloc(sizeof(byte) * size);
-
-	/* read the body in */
-	fread((void*)tga->img, (sizeof(byte) * size), 1, fptr);
-
-	fclose(fptr);
+	/* image type without the RLE bit, bytes per stored pixel */
+	type = (tga->header.image_type & ~8);
+	bpp = ((tga->header.depth + 7) / 8);
+	
+	if ((tga->header.width <= 0) || (tga->header.height <= 0) ||
+		(tga->header.width > TGA_MAX_SIZE) || (tga->header.height > TGA_MAX_SIZE) ||
+		((tga->header.image_type != type) && (tga->header.image_type != (type | 8))) ||
+		((type == 1) && ((tga->header.color_map_type != 1) || ((bpp != 1) && (bpp != 2)))) ||
+		((type == 2) && (bpp != 2) && (bpp != 3) && (bpp != 4)) ||
+		((type == 3) && (bpp != 1)) ||
+		((type < 1) || (type > 3)))
+		goto corrupt;
+	
+	count = ((size_t)tga->header.width * tga->header.height);
+	size = (count * bpp);
+	
+	/* skip the id field */
+	src = (data + 18 + tga->header.ident_size);
+	
+	if (src > end)
+		goto corrupt;
+	
+	/* the color map follows, only color mapped images use it */
+	if (tga->header.color_map_type) {
+		entry = ((tga->header.color_map_bits + 7) / 8);
+		if ((tga->header.color_map_len < 0) || (entry > 4) || ((long)(tga->header.color_map_len * entry) > (end - src)))
+			goto corrupt;
+		
+		if (type == 1) {
+			if ((tga->header.color_map_len == 0) || (tga->header.color_map_start < 0) || (entry < 2))
+				goto corrupt;
+			
+			/* kept as BGR or BGRA */
+			palette = (byte*)malloc(tga->header.color_map_len * 4);
+			if (!palette)
+				goto corrupt;
+			
+			if (entry == 2) {
+				tga_expand_16(src, palette, tga->header.color_map_len);
+				palette_bpp = 3;
+			} else {
+				memcpy(palette, src, (tga->header.color_map_len * entry));
+				palette_bpp = entry;
+			}
+		}
+		
+		src += (tga->header.color_map_len * entry);
+	}
+	
+	if ((tga->header.image_type == 2) && (bpp == 4) && ((tga->header.desc & 0x30) == 0x20)) {
+		if (size > (size_t)(end - src))
+			goto corrupt;
+		
+		/* the texture owns the mapping now */
+		tga->img = (byte*)src;
+		tga->mapped = data;
+		tga->mapped_len = len;
+		tga->header.depth = bpp;
+		data = NULL;
+	} else {
+		/*
+		 *	The image body.  No RLE packet (a byte and a pixel) makes
+		 *	more than 128 pixels, so a header claiming more than that
+		 *	is rejected before anything is allocated for it.
+		 */
+		if (size > ((size_t)(end - src) * ((tga->header.image_type & 8) ? 128 : 1)))
+			goto corrupt;
+		
+		pixels = (byte*)malloc(size);
+		if (!pixels)
+			goto corrupt;
+		
+		if (tga->header.image_type & 8) {
+			if (!tga_decode_rle(src, end, pixels, count, bpp))
+				goto corrupt;
+		} else
+			memcpy(pixels, src, size);
+		
+		unmap_file(data, len);
+		data = NULL;
+		
+		/* convert to something OpenGL takes directly */
+		if (type == 1) {
+			tga->img = (byte*)malloc(count * palette_bpp);
+			if (!tga->img)
+				goto corrupt;
+		
+			for (p = 0; p < count; ++p) {
+				index = ((bpp == 1) ? pixels[p] : (pixels[p * 2] | (pixels[(p * 2) + 1] << 8)));
+				index -= tga->header.color_map_start;
+				if ((index < 0) || (index >= tga->header.color_map_len))
+					index = 0;
+				memcpy((tga->img + (p * palette_bpp)), (palette + (index * palette_bpp)), palette_bpp);
+			}
+		
+			tga->header.depth = palette_bpp;
+			free(pixels);
+		} else if (bpp == 2) {
+			tga->img = (byte*)malloc(count * 3);
+			if (!tga->img)
+				goto corrupt;
+		
+			tga_expand_16(pixels, tga->img, count);
+			tga->header.depth = 3;
+			free(pixels);
+		} else {
+			tga->img = pixels;
+			tga->header.depth = bpp;
+		}
+		pixels = NULL;
+		free(palette);
+	}
+	
+	/* the texture coordinates expect the top row first */
+	tga_flip(tga);
+	
+	#ifdef USE_MIPMAPS
+		if (!uncompressed)
+			mipmap_build(tga);
+	#endif
+	
+	#ifdef USE_TEXTURE_COMPRESSION
+		if (!uncompressed && tga_compress(tga, file)) {
+			tga_hash(tga);
+			return tga;
+		}
+	#endif
+	
+	#if !defined(USE_MIPMAPS) && !defined(USE_TEXTURE_COMPRESSION)
+	(void)uncompressed;	/* get rid of unused variable warning */
+	#endif
 	
 	/*
-	 *	Check for horizontal/vertical flipping.
-	 *	This value should be used to determine if
-	 *	the texture coordinate needs to be 1-coord
+	 *	Optimization.
+	 *
+	 *	Most drivers convert GL_BGR and GL_LUMINANCE to
+	 *	their own 32 bit format one pixel at a time while
+	 *	the upload waits, BGRA goes straight through.
 	 */
-	tga->vflip = 1;
-	tga->hflip = 0;
-	if (tga->header.desc & 0x20)
-		tga->vflip = 0;
-	if (tga->header.desc & 0x10)
-		tga->hflip = 1;
-
-	/* select bit-mode for opengl */
-	switch ((int)tga->header.depth) {
-		case 1:
-			tga->gl_format = GL_LUMINANCE;
-			break;
-		case 3:
-			tga->gl_format = GL_BGR;
-			break;
-		case 4:
-			tga->gl_format = GL_BGRA;
-			break;
-	};
-	tga->gl_compontents = tga->header.depth;
+	if (tga->header.depth != 4) {
+		pixels = tga_expand_bgra(tga->img, count, tga->header.depth);
+		if (!pixels)
+			goto corrupt;
+		tga_free_img(tga);
+		tga->img = pixels;
+		pixels = NULL;
+		
+		for (i = 0, w = tga->header.width, h = tga->header.height; i < tga->num_mips; ++i) {
+			w = ((w > 1) ? (w / 2) : 1);
+			h = ((h > 1) ? (h / 2) : 1);
+			pixels = tga_expand_bgra(tga->mips[i], ((size_t)w * h), tga->header.depth);
+			if (!pixels)
+				goto corrupt;
+			free(tga->mips[i]);
+			tga->mips[i] = pixels;
+			pixels = NULL;
+		}
+		tga->header.depth = 4;
+	}
+	tga->gl_format = GL_BGRA;
+	tga->gl_compontents = GL_RGBA8;
+	
+	tga_hash(tga);
 
 	return tga;
+	
+corrupt:
+	printf("ERROR: Texture file \"%s\" is corrupt or not a supported TGA.\n", file);
+	unmap_file(data, len);
+	free(palette);
+	free(pixels);
+	mipmap_free(tga);
+	tga_free_img(tga);
+	free(tga);
+	return NULL;
 };
 
 
@@ -88,6 +306,313 @@ struct tga_t* load_tga(char* file) {
 void free_tga(struct tga_t* tga) {
 	if (!tga)
 		return;
-	free(tga->img);
+	mipmap_free(tga);
+	tga_free_img(tga);
 	free(tga);
 }
+
+
+/*
+ *	Free img, or unmap the file it points into.
+ */
+void tga_free_img(struct tga_t* tga) {
+	if (tga->mapped)
+		unmap_file(tga->mapped, tga->mapped_len);
+	else
+		free(tga->img);
+	
+	tga->img = NULL;
+	tga->mapped = NULL;
+	tga->mapped_len = 0;
+}
+
+
+/*
+ *	Check if two textures have the same pixels.
+ *
+ *	Only level 0 is compared, the mipmaps are made from it.
+ *	A texture whose pixels have been freed is never the same
+ *	as another, see tga_reload().
+ */
+int tga_same(struct tga_t* a, struct tga_t* b) {
+	byte* pa = NULL;
+	byte* pb = NULL;
+	long la = 0;
+	long lb = 0;
+	
+	if (!tga_same_hash(a, b) || !a->img || !b->img)
+		return 0;
+	
+	pa = tga_pixels(a, &la);
+	pb = tga_pixels(b, &lb);
+	
+	return ((la == lb) && !memcmp(pa, pb, la));
+}
+
+
+/*
+ *	Check if two textures are the same size and format and
+ *	have the same two hashes of level 0 (64 bits between
+ *	them), which still works once their pixels are freed.
+ */
+int tga_same_hash(struct tga_t* a, struct tga_t* b) {
+	return ((a->hash == b->hash) && (a->digest == b->digest) && (a->compressed == b->compressed) &&
+			(a->header.width == b->header.width) && (a->header.height == b->header.height) &&
+			(a->header.depth == b->header.depth));
+}
+
+
+/*
+ *	Hash the pixels (or blocks) of level 0 into hash and digest.
+ */
+void tga_hash(struct tga_t* tga) {
+	byte* pixels = NULL;
+	long len = 0;
+	
+	pixels = tga_pixels(tga, &len);
+	tga->hash = hash_fnv1a(pixels, len);
+	tga->digest = hash_murmur3(pixels, len, 0);
+}
+
+
+/*
+ *	Free the pixels (or blocks) of a texture, keeping
+ *	everything that describes it.
+ */
+void tga_free_pixels(struct tga_t* tga) {
+	int i = 0;
+	
+	for (i = 0; i < TGA_MAX_MIPS; ++i) {
+		free(tga->mips[i]);
+		tga->mips[i] = NULL;
+	}
+	for (i = 0; i <= TGA_MAX_MIPS; ++i)
+		tga->blocks[i] = NULL;
+	
+	tga_free_img(tga);
+}
+
+
+/*
+ *	Read the pixels of a texture back in after tga_free_pixels().
+ *
+ *	The texture keeps its hashes (they are what the world
+ *	knows it by) even if the file has changed since.
+ *
+ *	Returns 0 if the file can not be read.
+ */
+int tga_reload(struct tga_t* tga, char* file) {
+	struct tga_t* fresh = load_tga(file);
+	
+	if (!fresh)
+		return 0;
+	
+	tga_free_pixels(tga);
+	fresh->hash = tga->hash;
+	fresh->digest = tga->digest;
+	memcpy(tga, fresh, sizeof(struct tga_t));
+	free(fresh);
+	
+	return 1;
+}
+
+
+/*
+ *	Bytes a texture takes in OpenGL from level first_level
+ *	down to 1x1.
+ */
+long tga_gpu_size(struct tga_t* tga, int first_level) {
+	long size = 0;
+	int level = 0;
+	int w = tga->header.width;
+	int h = tga->header.height;
+	
+	for (; level <= tga->num_mips; ++level) {
+		if (level >= first_level)
+			size += (tga->compressed ? tga->blocks_len[level] : ((long)w * h * 4));
+		w = ((w > 1) ? (w / 2) : 1);
+		h = ((h > 1) ? (h / 2) : 1);
+	}
+	
+	return size;
+}
+
+
+/*
+ *	Get the pixels (or blocks) of level 0.
+ */
+static byte* tga_pixels(struct tga_t* tga, long* len) {
+	if (tga->compressed) {
+		*len = tga->blocks_len[0];
+		return tga->blocks[0];
+	}
+	
+	*len = ((long)tga->header.width * tga->header.height * tga->header.depth);
+	return tga->img;
+}
+
+
+/*
+ *	Decode run-length encoded pixels (bpp bytes each) from src
+ *	into dst until pixels pixels have been decoded.
+ *
+ *	Each packet starts with a byte; the low 7 bits are the number
+ *	of pixels minus one.  If the high bit is set one pixel follows
+ *	that is repeated, otherwise that many literal pixels follow.
+ *	Packets may run across scanlines.
+ *
+ *	Optimization.
+ *
+ *	Literal packets are copied with a single memcpy() and repeats
+ *	are filled by doubling, so neither goes pixel by pixel.
+ *	Every copy is bounded by what is left of src and dst.
+ *
+ *	Returns NULL if src ends before the image does.
+ */
+static const byte* tga_decode_rle(const byte* src, const byte* end, byte* dst, size_t pixels, int bpp) {
+	byte* dst_end = (dst + (pixels * bpp));
+	size_t bytes = 0;
+	int run = 0;
+	
+	while (dst < dst_end) {
+		if (src >= end)
+			return NULL;
+		
+		run = (*src & 0x80);
+		bytes = ((size_t)((*src & 0x7f) + 1) * bpp);
+		++src;
+		
+		/* a packet running past the end of the image is cut short */
+		if (bytes > (size_t)(dst_end - dst))
+			bytes = (size_t)(dst_end - dst);
+		
+		if (run) {
+			if ((end - src) < bpp)
+				return NULL;
+			tga_fill(dst, src, bpp, bytes);
+			src += bpp;
+		} else {
+			if ((size_t)(end - src) < bytes)
+				return NULL;
+			memcpy(dst, src, bytes);
+			src += bytes;
+		}
+		
+		dst += bytes;
+	}
+	
+	return src;
+}
+
+
+/*
+ *	Fill bytes bytes of dst with a pixel of bpp bytes.
+ */
+static void tga_fill(byte* dst, const byte* pixel, int bpp, size_t bytes) {
+	size_t done = bpp;
+	size_t n = 0;
+	
+	if (bpp == 1) {
+		memset(dst, *pixel, bytes);
+		return;
+	}
+	
+	memcpy(dst, pixel, bpp);
+	
+	/* copy what has been filled so far onto the rest */
+	while (done < bytes) {
+		n = ((done < (bytes - done)) ? done : (bytes - done));
+		memcpy((dst + done), dst, n);
+		done += n;
+	}
+}
+
+
+/*
+ *	Expand 15/16 bit pixels (5 bits each of red, green and blue)
+ *	into BGR.
+ */
+static void tga_expand_16(const byte* src, byte* dst, size_t pixels) {
+	size_t i = 0;
+	int v = 0;
+	int c = 0;
+	
+	for (; i < pixels; ++i, src += 2, dst += 3) {
+		v = (src[0] | (src[1] << 8));
+		
+		c = (v & 0x1f);			dst[0] = (byte)((c << 3) | (c >> 2));
+		c = ((v >> 5) & 0x1f);	dst[1] = (byte)((c << 3) | (c >> 2));
+		c = ((v >> 10) & 0x1f);	dst[2] = (byte)((c << 3) | (c >> 2));
+	}
+}
+
+
+/*
+ *	Flip the image so the top row comes first and the left
+ *	column comes first, whichever corner the file started in.
+ */
+static void tga_flip(struct tga_t* tga) {
+	byte pixel[4];
+	byte* row = NULL;
+	byte* top = NULL;
+	byte* bottom = NULL;
+	int depth = tga->header.depth;
+	size_t stride = ((size_t)tga->header.width * depth);
+	size_t x = 0;
+	int y = 0;
+	
+	/* bit 5 clear means the bottom row was stored first */
+	if (!(tga->header.desc & 0x20)) {
+		for (y = 0; y < (tga->header.height / 2); ++y) {
+			top = (tga->img + (y * stride));
+			bottom = (tga->img + ((tga->header.height - 1 - y) * stride));
+			for (x = 0; x < stride; ++x) {
+				pixel[0] = top[x];
+				top[x] = bottom[x];
+				bottom[x] = pixel[0];
+			}
+		}
+	}
+	
+	/* bit 4 set means the right column was stored first */
+	if (tga->header.desc & 0x10) {
+		for (y = 0; y < tga->header.height; ++y) {
+			row = (tga->img + (y * stride));
+			for (x = 0; x < (size_t)(tga->header.width / 2); ++x) {
+				memcpy(pixel, (row + (x * depth)), depth);
+				memcpy((row + (x * depth)), (row + ((tga->header.width - 1 - x) * depth)), depth);
+				memcpy((row + ((tga->header.width - 1 - x) * depth)), pixel, depth);
+			}
+		}
+	}
+	
+	tga->header.desc = ((tga->header.desc & ~0x30) | 0x20);
+}
+
+
+/*
+ *	Expand greyscale or BGR pixels to BGRA.
+ *
+ *	Returns a new buffer, or NULL if out of memory.
+ */
+static byte* tga_expand_bgra(byte* src, size_t pixels, int depth) {
+	byte* dst = (byte*)malloc(pixels * 4);
+	byte* out = dst;
+	size_t i = 0;
+	
+	if (!dst)
+		return NULL;
+	
+	for (; i < pixels; ++i, src += depth, out += 4) {
+		if (depth == 1) {
+			out[0] = out[1] = out[2] = src[0];
+		} else {
+			out[0] = src[0];
+			out[1] = src[1];
+			out[2] = src[2];
+		}
+		out[3] = 255;
+	}
+	
+	return dst;
+}
@@ -0,0 +1,740 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	Block compressed textures.
+ *
+ *	See tga_compress.h for the cache file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "definitions.h"
+#include "util.h"
+#include "tga.h"
+#include "tga_compress.h"
+
+#ifdef _WIN32
+	typedef void (APIENTRY *tga_compressed_tex_image_2d_t)(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei image_size, const GLvoid* data);
+#endif
+
+static int tga_compress_levels(struct tga_t* tga, char* file);
+static int tga_source_matches(char* file, struct tgac_header_t* hdr);
+static int tga_cache_valid(struct tgac_header_t* hdr, long len);
+static void tga_get_block(const byte* src, int width, int height, int depth, int x, int y, byte* block);
+static void tga_encode_color(const byte* block, byte* dst);
+static void tga_encode_alpha(const byte* block, byte* dst);
+static void tga_decode_level(const byte* src, int format, int width, int height, byte* dst);
+static void tga_decode_color(const byte* src, int four_color, byte* block);
+static void tga_decode_alpha(const byte* src, byte* block);
+
+
+/*
+ *	Load a texture from the cache of the given TGA file.
+ *
+ *	Returns NULL if there is no cache or it is out of date, in
+ *	which case the TGA file has to be loaded and compressed.
+ */
+struct tga_t* tga_load_compressed(char* file) {
+	struct tga_t* tga = NULL;
+	struct tgac_header_t* hdr = NULL;
+	byte* data = NULL;
+	long len = 0;
+	int i = 0;
+	char cfile[1024];
+	
+	if ((strlen(file) + strlen(TGAC_EXTENSION)) >= sizeof(cfile))
+		return NULL;
+	sprintf(cfile, "%s%s", file, TGAC_EXTENSION);
+	
+	data = (byte*)map_file(cfile, &len);
+	if (!data)
+		return NULL;
+	hdr = (struct tgac_header_t*)data;
+	
+	if ((len < (long)sizeof(struct tgac_header_t)) ||
+		(hdr->ident != TGAC_IDENT) || (hdr->version != TGAC_VERSION) ||
+		(hdr->file_len != len) ||
+		!tga_source_matches(file, hdr))
+	{
+		unmap_file(data, len);
+		return NULL;
+	}
+	
+	if (!tga_cache_valid(hdr, len) ||
+		(hash_fnv1a((data + sizeof(struct tgac_header_t)), (len - (long)sizeof(struct tgac_header_t))) != hdr->blocks_hash))
+	{
+		printf("WARNING: Compressed texture \"%s\" is corrupt, ignoring it.\n", cfile);
+		unmap_file(data, len);
+		return NULL;
+	}
+	
+	tga = (struct tga_t*)malloc(sizeof(struct tga_t));
+	if (!tga) {
+		unmap_file(data, len);
+		return NULL;
+	}
+	memset(tga, 0, sizeof(struct tga_t));
+	
+	/*
+	 *	Optimization.
+	 *
+	 *	The blocks are uploaded straight out of the mapped
+	 *	cache, it is unmapped when they are freed.
+	 */
+	tga->img = data;
+	tga->mapped = data;
+	tga->mapped_len = len;
+	
+	tga->header.width = (short)hdr->width;
+	tga->header.height = (short)hdr->height;
+	tga->header.depth = (byte)hdr->depth;
+	tga->header.desc = 0x20;
+	
+	/* what the blocks are decoded to when OpenGL has no S3TC */
+	tga->gl_format = GL_BGRA;
+	tga->gl_compontents = ((hdr->format == TGA_BC3) ? GL_RGBA8 : GL_RGB8);
+	
+	tga->compressed = hdr->format;
+	tga->num_mips = (hdr->num_levels - 1);
+	for (i = 0; i < hdr->num_levels; ++i) {
+		tga->blocks[i] = (tga->img + hdr->ofs_levels[i]);
+		tga->blocks_len[i] = hdr->len_levels[i];
+	}
+	
+	return tga;
+}
+
+
+/*
+ *	Compress a loaded texture and its mipmaps and write
+ *	the cache for the given TGA file.
+ *
+ *	The uncompressed image and mipmaps are freed, after this
+ *	the texture only has blocks.  If the cache can not be
+ *	written the texture is still compressed, it will just
+ *	be compressed again next time.
+ *
+ *	Safe to call from any thread.
+ *
+ *	Returns 0 if the texture could not be compressed, in
+ *	which case it is left as it is.
+ */
+int tga_compress(struct tga_t* tga, char* file) {
+	return tga_compress_levels(tga, file);
+}
+
+
+/*
+ *	Compress a texture that has no TGA file (ie: one made
+ *	at run time), the same as tga_compress() but no cache
+ *	is written.
+ */
+int tga_compress_in_memory(struct tga_t* tga) {
+	return tga_compress_levels(tga, NULL);
+}
+
+
+/*
+ *	Compress a texture, writing the cache for file unless it is NULL.
+ */
+static int tga_compress_levels(struct tga_t* tga, char* file) {
+	struct tgac_header_t layout;
+	FILE* fptr = NULL;
+	byte* buf = NULL;
+	byte* src = NULL;
+	byte* dst = NULL;
+	long src_len = 0;
+	long ofs = 0;
+	unsigned int size = 0;
+	unsigned int mtime = 0;
+	int level = 0;
+	int depth = 0;
+	int w = 0;
+	int h = 0;
+	int x = 0;
+	int y = 0;
+	int ok = 0;
+	byte block[16 * 4];
+	char cfile[1024];
+	char tmp_file[sizeof(cfile) + TEMP_FILE_EXTRA];
+	
+	depth = tga->header.depth;
+	if (tga->compressed || !tga->img || ((depth != 1) && (depth != 3) && (depth != 4)) ||
+		(tga->num_mips >= TGAC_MAX_LEVELS) ||
+		(file && ((strlen(file) + strlen(TGAC_EXTENSION)) >= sizeof(cfile))))
+		return 0;
+	if (file)
+		sprintf(cfile, "%s%s", file, TGAC_EXTENSION);
+	
+	memset(&layout, 0, sizeof(struct tgac_header_t));
+	layout.ident = TGAC_IDENT;
+	layout.version = TGAC_VERSION;
+	layout.width = tga->header.width;
+	layout.height = tga->header.height;
+	layout.depth = depth;
+	layout.format = ((depth == 4) ? TGA_BC3 : TGA_BC1);
+	layout.num_levels = (tga->num_mips + 1);
+	
+	/* lay out the levels, each one is halved the same way mipmap_build() does */
+	ofs = sizeof(struct tgac_header_t);
+	for (level = 0, w = layout.width, h = layout.height; level < layout.num_levels; ++level) {
+		layout.ofs_levels[level] = ofs;
+		layout.len_levels[level] = TGA_COMPRESSED_SIZE(layout.format, w, h);
+		ofs += layout.len_levels[level];
+		
+		w = ((w > 1) ? (w / 2) : 1);
+		h = ((h > 1) ? (h / 2) : 1);
+	}
+	layout.file_len = (int)ofs;
+	
+	buf = (byte*)malloc(layout.file_len);
+	if (!buf)
+		return 0;
+	
+	for (level = 0, w = layout.width, h = layout.height; level < layout.num_levels; ++level) {
+		src = (level ? tga->mips[level - 1] : tga->img);
+		dst = (buf + layout.ofs_levels[level]);
+		
+		for (y = 0; y < h; y += 4) {
+			for (x = 0; x < w; x += 4) {
+				tga_get_block(src, w, h, depth, x, y, block);
+				
+				if (layout.format == TGA_BC3) {
+					tga_encode_alpha(block, dst);
+					dst += 8;
+				}
+				tga_encode_color(block, dst);
+				dst += 8;
+			}
+		}
+		
+		w = ((w > 1) ? (w / 2) : 1);
+		h = ((h > 1) ? (h / 2) : 1);
+	}
+	
+	/* stamp it with the TGA file so a changed texture is compressed again */
+	src = (file ? (byte*)map_file(file, &src_len) : NULL);
+	if (src && file_stamp(file, &size, &mtime)) {
+		layout.src_size = size;
+		layout.src_mtime = mtime;
+		layout.src_hash = hash_fnv1a(src, src_len);
+		layout.blocks_hash = hash_fnv1a((buf + sizeof(struct tgac_header_t)), (layout.file_len - (long)sizeof(struct tgac_header_t)));
+		memcpy(buf, &layout, sizeof(struct tgac_header_t));
+		
+		/*
+		 *	Write to a temporary file first so a
+		 *	half written cache is never picked up.
+		 *	Each writer has its own, two loading the
+		 *	same texture at once do not mix them up.
+		 */
+		fptr = open_temp_file(cfile, tmp_file);
+		if (fptr) {
+			ok = (fwrite(buf, layout.file_len, 1, fptr) == 1);
+			ok = (!fclose(fptr) && ok);
+			
+			#ifdef _WIN32
+				/* rename() will not replace an existing file */
+				if (ok)
+					remove(cfile);
+			#endif
+			
+			if (!ok || rename(tmp_file, cfile))
+				remove(tmp_file);
+		}
+	} else
+		memcpy(buf, &layout, sizeof(struct tgac_header_t));
+	unmap_file(src, src_len);
+	
+	/* swap the pixels for the blocks */
+	for (level = 0; level < tga->num_mips; ++level) {
+		free(tga->mips[level]);
+		tga->mips[level] = NULL;
+	}
+	tga_free_img(tga);
+	
+	tga->img = buf;
+	tga->compressed = layout.format;
+	tga->gl_format = GL_BGRA;
+	tga->gl_compontents = ((layout.format == TGA_BC3) ? GL_RGBA8 : GL_RGB8);
+	for (level = 0; level < layout.num_levels; ++level) {
+		tga->blocks[level] = (buf + layout.ofs_levels[level]);
+		tga->blocks_len[level] = layout.len_levels[level];
+	}
+	
+	return 1;
+}
+
+
+/*
+ *	Upload levels first_level to last_level of a compressed
+ *	texture to the same levels of the bound OpenGL texture.
+ *
+ *	If OpenGL can not take the blocks as they are each
+ *	level is decoded and uploaded as BGRA.
+ */
+void tga_upload_compressed(struct tga_t* tga, int first_level, int last_level) {
+	static int has_s3tc = -1;
+	#ifdef _WIN32
+		static tga_compressed_tex_image_2d_t glCompressedTexImage2D = NULL;
+	#endif
+	const char* extensions = NULL;
+	byte* pixels = NULL;
+	int level = 0;
+	int w = 0;
+	int h = 0;
+	
+	if (has_s3tc == -1) {
+		extensions = (const char*)glGetString(GL_EXTENSIONS);
+		has_s3tc = (extensions && strstr(extensions, "GL_EXT_texture_compression_s3tc"));
+		
+		#ifdef _WIN32
+			/* opengl32.dll stops at OpenGL 1.1 */
+			if (has_s3tc)
+				glCompressedTexImage2D = (tga_compressed_tex_image_2d_t)wglGetProcAddress("glCompressedTexImage2DARB");
+			has_s3tc = (glCompressedTexImage2D != NULL);
+		#endif
+		
+		#ifdef _DEBUG
+		printf("Compressed textures are %s.\n", (has_s3tc ? "uploaded as S3TC" : "decoded before upload"));
+		#endif
+	}
+	
+	if (!has_s3tc) {
+		pixels = (byte*)malloc(tga->header.width * tga->header.height * 4);
+		if (!pixels)
+			return;
+	}
+	
+	for (level = 0, w = tga->header.width, h = tga->header.height; level <= last_level; ++level) {
+		if (level < first_level) {
+			w = ((w > 1) ? (w / 2) : 1);
+			h = ((h > 1) ? (h / 2) : 1);
+			continue;
+		}
+		
+		if (has_s3tc) {
+			glCompressedTexImage2D(
+						GL_TEXTURE_2D,
+						level,
+						((tga->compressed == TGA_BC3) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT),
+						w,
+						h,
+						0,
+						tga->blocks_len[level],
+						tga->blocks[level]
+			);
+		} else {
+			tga_decode_level(tga->blocks[level], tga->compressed, w, h, pixels);
+			glTexImage2D(GL_TEXTURE_2D, level, tga->gl_compontents, w, h, 0, tga->gl_format, GL_UNSIGNED_BYTE, pixels);
+		}
+		
+		w = ((w > 1) ? (w / 2) : 1);
+		h = ((h > 1) ? (h / 2) : 1);
+	}
+	
+	free(pixels);
+}
+
+
+/*
+ *	Decode a level of a compressed texture into BGRA.
+ *	dst needs room for 4 bytes per pixel of the level.
+ */
+void tga_decompress(struct tga_t* tga, int level, byte* dst) {
+	int w = tga->header.width;
+	int h = tga->header.height;
+	int i = 0;
+	
+	for (; i < level; ++i) {
+		w = ((w > 1) ? (w / 2) : 1);
+		h = ((h > 1) ? (h / 2) : 1);
+	}
+	
+	tga_decode_level(tga->blocks[level], tga->compressed, w, h, dst);
+}
+
+
+/*
+ *	Check that the TGA file is the one the cache was made from.
+ *	The size and modification time are trusted if they match,
+ *	otherwise the file is hashed.
+ */
+static int tga_source_matches(char* file, struct tgac_header_t* hdr) {
+	unsigned int size = 0;
+	unsigned int mtime = 0;
+	unsigned int hash = 0;
+	byte* src = NULL;
+	long len = 0;
+	
+	if (!file_stamp(file, &size, &mtime) || (size != hdr->src_size))
+		return 0;
+	
+	if (mtime == hdr->src_mtime)
+		return 1;
+	
+	src = (byte*)map_file(file, &len);
+	if (!src)
+		return 0;
+	hash = hash_fnv1a(src, len);
+	unmap_file(src, len);
+	
+	return (hash == hdr->src_hash);
+}
+
+
+/*
+ *	Check that every level of a cache file is where and
+ *	as big as it should be.
+ */
+static int tga_cache_valid(struct tgac_header_t* hdr, long len) {
+	int level = 0;
+	int w = hdr->width;
+	int h = hdr->height;
+	
+	if ((w <= 0) || (h <= 0) || (w > 0x7fff) || (h > 0x7fff) ||
+		((hdr->depth != 1) && (hdr->depth != 3) && (hdr->depth != 4)) ||
+		(hdr->format != ((hdr->depth == 4) ? TGA_BC3 : TGA_BC1)) ||
+		(hdr->num_levels < 1) || (hdr->num_levels > TGAC_MAX_LEVELS))
+		return 0;
+	
+	for (; level < hdr->num_levels; ++level) {
+		if ((hdr->len_levels[level] != TGA_COMPRESSED_SIZE(hdr->format, w, h)) ||
+			(hdr->ofs_levels[level] < (int)sizeof(struct tgac_header_t)) ||
+			(hdr->ofs_levels[level] > len) ||
+			(hdr->len_levels[level] > (len - hdr->ofs_levels[level])))
+			return 0;
+		
+		/* nothing past 1x1 */
+		if ((level < (hdr->num_levels - 1)) && (w == 1) && (h == 1))
+			return 0;
+		
+		w = ((w > 1) ? (w / 2) : 1);
+		h = ((h > 1) ? (h / 2) : 1);
+	}
+	
+	return 1;
+}
+
+
+/*
+ *	Copy the 4x4 block at x, y of an image of depth bytes per
+ *	pixel into block as RGBA.
+ *	Blocks running off the right or bottom of the image repeat
+ *	the last column or row.
+ */
+static void tga_get_block(const byte* src, int width, int height, int depth, int x, int y, byte* block) {
+	const byte* pixel = NULL;
+	int px = 0;
+	int py = 0;
+	int i = 0;
+	int j = 0;
+	
+	for (j = 0; j < 4; ++j) {
+		py = (((y + j) < height) ? (y + j) : (height - 1));
+		
+		for (i = 0; i < 4; ++i, block += 4) {
+			px = (((x + i) < width) ? (x + i) : (width - 1));
+			pixel = (src + (((py * width) + px) * depth));
+			
+			if (depth == 1) {
+				block[0] = block[1] = block[2] = pixel[0];
+				block[3] = 255;
+			} else {
+				block[0] = pixel[2];
+				block[1] = pixel[1];
+				block[2] = pixel[0];
+				block[3] = ((depth == 4) ? pixel[3] : 255);
+			}
+		}
+	}
+}
+
+
+/*
+ *	Encode the color of an RGBA block as a BC1 block.
+ *
+ *	The end points are the corners of the bounding box of the
+ *	colors, pulled in by 1/16th of its size so the in between
+ *	colors land closer to the colors actually used.  Each pixel
+ *	then takes whichever of the four colors is nearest.
+ *
+ *	The first color is always kept above the second so the
+ *	block is never read as a block with transparency.
+ */
+static void tga_encode_color(const byte* block, byte* dst) {
+	int lo[3] = { 255, 255, 255 };
+	int hi[3] = { 0, 0, 0 };
+	int palette[4][3];
+	int c0 = 0;
+	int c1 = 0;
+	int inset = 0;
+	int best = 0;
+	int dist = 0;
+	int d = 0;
+	unsigned int indices = 0;
+	int i = 0;
+	int j = 0;
+	int k = 0;
+	
+	for (i = 0; i < 16; ++i) {
+		for (k = 0; k < 3; ++k) {
+			if (block[(i * 4) + k] < lo[k])
+				lo[k] = block[(i * 4) + k];
+			if (block[(i * 4) + k] > hi[k])
+				hi[k] = block[(i * 4) + k];
+		}
+	}
+	
+	for (k = 0; k < 3; ++k) {
+		inset = ((hi[k] - lo[k]) >> 4);
+		lo[k] += inset;
+		hi[k] -= inset;
+	}
+	
+	/* round to 5:6:5 */
+	c0 = ((((hi[0] * 31) + 127) / 255) << 11) | ((((hi[1] * 63) + 127) / 255) << 5) | (((hi[2] * 31) + 127) / 255);
+	c1 = ((((lo[0] * 31) + 127) / 255) << 11) | ((((lo[1] * 63) + 127) / 255) << 5) | (((lo[2] * 31) + 127) / 255);
+	
+	if (c0 != c1) {
+		/* the colors the decoder will see */
+		palette[0][0] = (((c0 >> 11) << 3) | (c0 >> 13));
+		palette[0][1] = ((((c0 >> 5) & 0x3f) << 2) | ((c0 >> 9) & 0x3));
+		palette[0][2] = (((c0 & 0x1f) << 3) | ((c0 >> 2) & 0x7));
+		palette[1][0] = (((c1 >> 11) << 3) | (c1 >> 13));
+		palette[1][1] = ((((c1 >> 5) & 0x3f) << 2) | ((c1 >> 9) & 0x3));
+		palette[1][2] = (((c1 & 0x1f) << 3) | ((c1 >> 2) & 0x7));
+		for (k = 0; k < 3; ++k) {
+			palette[2][k] = (((2 * palette[0][k]) + palette[1][k]) / 3);
+			palette[3][k] = ((palette[0][k] + (2 * palette[1][k])) / 3);
+		}
+		
+		for (i = 0; i < 16; ++i) {
+			best = 0;
+			dist = 0x7fffffff;
+			for (j = 0; j < 4; ++j) {
+				d = ((block[(i * 4) + 0] - palette[j][0]) * (block[(i * 4) + 0] - palette[j][0])) +
+					((block[(i * 4) + 1] - palette[j][1]) * (block[(i * 4) + 1] - palette[j][1])) +
+					((block[(i * 4) + 2] - palette[j][2]) * (block[(i * 4) + 2] - palette[j][2]));
+				if (d < dist) {
+					dist = d;
+					best = j;
+				}
+			}
+			indices |= ((unsigned int)best << (i * 2));
+		}
+	}
+	
+	/* a flat block has every index at 0 */
+	dst[0] = (byte)(c0 & 0xff);
+	dst[1] = (byte)(c0 >> 8);
+	dst[2] = (byte)(c1 & 0xff);
+	dst[3] = (byte)(c1 >> 8);
+	dst[4] = (byte)(indices & 0xff);
+	dst[5] = (byte)((indices >> 8) & 0xff);
+	dst[6] = (byte)((indices >> 16) & 0xff);
+	dst[7] = (byte)(indices >> 24);
+}
+
+
+/*
+ *	Encode the alpha of an RGBA block as the alpha half of a
+ *	BC3 block, eight steps between the (pulled in) extremes.
+ */
+static void tga_encode_alpha(const byte* block, byte* dst) {
+	int palette[8];
+	int lo = 255;
+	int hi = 0;
+	int inset = 0;
+	int best = 0;
+	int dist = 0;
+	int d = 0;
+	unsigned int bits = 0;
+	int pending = 0;
+	int i = 0;
+	int j = 0;
+	
+	for (i = 0; i < 16; ++i) {
+		if (block[(i * 4) + 3] < lo)
+			lo = block[(i * 4) + 3];
+		if (block[(i * 4) + 3] > hi)
+			hi = block[(i * 4) + 3];
+	}
+	
+	inset = ((hi - lo) >> 5);
+	lo += inset;
+	hi -= inset;
+	
+	dst[0] = (byte)hi;
+	dst[1] = (byte)lo;
+	memset(dst + 2, 0, 6);
+	
+	/* a flat block has every index at 0 */
+	if (hi == lo)
+		return;
+	
+	palette[0] = hi;
+	palette[1] = lo;
+	for (j = 1; j < 7; ++j)
+		palette[j + 1] = ((((7 - j) * hi) + (j * lo)) / 7);
+	
+	/* 3 bits a pixel, written out a byte at a time */
+	dst += 2;
+	for (i = 0; i < 16; ++i) {
+		best = 0;
+		dist = 256;
+		for (j = 0; j < 8; ++j) {
+			d = ABS((block[(i * 4) + 3] - palette[j]));
+			if (d < dist) {
+				dist = d;
+				best = j;
+			}
+		}
+		
+		bits |= ((unsigned int)best << pending);
+		pending += 3;
+		while (pending >= 8) {
+			*dst++ = (byte)(bits & 0xff);
+			bits >>= 8;
+			pending -= 8;
+		}
+	}
+}
+
+
+/*
+ *	Decode a level of a compressed texture into BGRA.
+ */
+static void tga_decode_level(const byte* src, int format, int width, int height, byte* dst) {
+	byte block[16 * 4];
+	byte* row = NULL;
+	int x = 0;
+	int y = 0;
+	int i = 0;
+	int j = 0;
+	
+	for (y = 0; y < height; y += 4) {
+		for (x = 0; x < width; x += 4) {
+			if (format == TGA_BC3) {
+				tga_decode_color((src + 8), 1, block);
+				tga_decode_alpha(src, block);
+				src += TGA_BC3_BLOCK;
+			} else {
+				tga_decode_color(src, 0, block);
+				src += TGA_BC1_BLOCK;
+			}
+			
+			/* the block may run off the image */
+			for (j = 0; (j < 4) && ((y + j) < height); ++j) {
+				row = (dst + ((((y + j) * width) + x) * 4));
+				for (i = 0; (i < 4) && ((x + i) < width); ++i, row += 4) {
+					row[0] = block[(((j * 4) + i) * 4) + 2];
+					row[1] = block[(((j * 4) + i) * 4) + 1];
+					row[2] = block[(((j * 4) + i) * 4) + 0];
+					row[3] = block[(((j * 4) + i) * 4) + 3];
+				}
+			}
+		}
+	}
+}
+
+
+/*
+ *	Decode a BC1 color block into RGBA.
+ *	Color blocks in BC3 always have four colors.
+ */
+static void tga_decode_color(const byte* src, int four_color, byte* block) {
+	int palette[4][4];
+	int c0 = (src[0] | (src[1] << 8));
+	int c1 = (src[2] | (src[3] << 8));
+	unsigned int indices = (src[4] | (src[5] << 8) | (src[6] << 16) | ((unsigned int)src[7] << 24));
+	int i = 0;
+	int k = 0;
+	
+	palette[0][0] = (((c0 >> 11) << 3) | (c0 >> 13));
+	palette[0][1] = ((((c0 >> 5) & 0x3f) << 2) | ((c0 >> 9) & 0x3));
+	palette[0][2] = (((c0 & 0x1f) << 3) | ((c0 >> 2) & 0x7));
+	palette[1][0] = (((c1 >> 11) << 3) | (c1 >> 13));
+	palette[1][1] = ((((c1 >> 5) & 0x3f) << 2) | ((c1 >> 9) & 0x3));
+	palette[1][2] = (((c1 & 0x1f) << 3) | ((c1 >> 2) & 0x7));
+	palette[0][3] = palette[1][3] = palette[2][3] = 255;
+	
+	if (four_color || (c0 > c1)) {
+		for (k = 0; k < 3; ++k) {
+			palette[2][k] = (((2 * palette[0][k]) + palette[1][k]) / 3);
+			palette[3][k] = ((palette[0][k] + (2 * palette[1][k])) / 3);
+		}
+		palette[3][3] = 255;
+	} else {
+		/* three colors and transparent black */
+		for (k = 0; k < 3; ++k) {
+			palette[2][k] = ((palette[0][k] + palette[1][k]) / 2);
+			palette[3][k] = 0;
+		}
+		palette[3][3] = 0;
+	}
+	
+	for (i = 0; i < 16; ++i, indices >>= 2, block += 4) {
+		block[0] = (byte)palette[indices & 3][0];
+		block[1] = (byte)palette[indices & 3][1];
+		block[2] = (byte)palette[indices & 3][2];
+		block[3] = (byte)palette[indices & 3][3];
+	}
+}
+
+
+/*
+ *	Decode the alpha half of a BC3 block into the alpha of an
+ *	RGBA block.
+ */
+static void tga_decode_alpha(const byte* src, byte* block) {
+	int palette[8];
+	int a0 = src[0];
+	int a1 = src[1];
+	unsigned int bits = 0;
+	int pending = 0;
+	int i = 0;
+	int j = 0;
+	
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1) {
+		for (j = 1; j < 7; ++j)
+			palette[j + 1] = ((((7 - j) * a0) + (j * a1)) / 7);
+	} else {
+		for (j = 1; j < 5; ++j)
+			palette[j + 1] = ((((5 - j) * a0) + (j * a1)) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	
+	src += 2;
+	for (i = 0; i < 16; ++i) {
+		if (pending < 3) {
+			bits |= ((unsigned int)*src++ << pending);
+			pending += 8;
+		}
+		
+		block[(i * 4) + 3] = (byte)palette[bits & 7];
+		bits >>= 3;
+		pending -= 3;
+	}
+}
@@ -0,0 +1,395 @@
+/*
+ *	This file is part of MenderD3
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ *	A small pool of worker threads.
+ *
+ *	Jobs are run in the order they were added.  A thread waiting
+ *	on a group runs queued jobs itself rather than sleeping, so a
+ *	pool with no workers (single CPU) still gets everything done.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <process.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+#include "definitions.h"
+#include "thread_pool.h"
+
+#define THREAD_POOL_MAX_THREADS		32
+
+struct thread_job_t {
+	struct thread_job_t* next;
+	thread_job_func_t func;
+	void* arg;
+	struct thread_group_t* group;
+};
+
+struct thread_pool_t {
+	int num_threads;
+	int quit;
+	
+	struct thread_job_t* head;			/* jobs waiting to be run		*/
+	struct thread_job_t* tail;
+	
+	#ifdef _WIN32
+		HANDLE threads[THREAD_POOL_MAX_THREADS];
+		CRITICAL_SECTION lock;
+		HANDLE work;					/* semaphore, one count per job	*/
+		HANDLE done;					/* set when any job finishes	*/
+	#else
+		pthread_t threads[THREAD_POOL_MAX_THREADS];
+		pthread_mutex_t lock;
+		pthread_cond_t work;
+		pthread_cond_t done;
+	#endif
+};
+
+#ifdef _WIN32
+	#define POOL_LOCK(_p)		EnterCriticalSection(&(_p)->lock)
+	#define POOL_UNLOCK(_p)		LeaveCriticalSection(&(_p)->lock)
+#else
+	#define POOL_LOCK(_p)		pthread_mutex_lock(&(_p)->lock)
+	#define POOL_UNLOCK(_p)		pthread_mutex_unlock(&(_p)->lock)
+#endif
+
+static struct thread_job_t* thread_pool_next_job(struct thread_pool_t* pool);
+static void thread_pool_run_job(struct thread_pool_t* pool, struct thread_job_t* job);
+
+#ifdef _WIN32
+	static unsigned __stdcall thread_pool_worker(void* arg);
+#else
+	static void* thread_pool_worker(void* arg);
+#endif
+
+
+/*
+ *	Create a thread pool.
+ *
+ *	If threads is 0 there is one worker per CPU
+ *	besides the thread that waits for the jobs.
+ *
+ *	Returns NULL on failure.
+ */
+struct thread_pool_t* thread_pool_create(int threads) {
+	struct thread_pool_t* pool = NULL;
+	int i = 0;
+	
+	if (threads <= 0)
+		threads = (cpu_count() - 1);
+	if (threads > THREAD_POOL_MAX_THREADS)
+		threads = THREAD_POOL_MAX_THREADS;
+	
+	pool = (struct thread_pool_t*)malloc(sizeof(struct thread_pool_t));
+	if (!pool)
+		return NULL;
+	memset(pool, 0, sizeof(struct thread_pool_t));
+	
+	#ifdef _WIN32
+		InitializeCriticalSection(&pool->lock);
+		pool->work = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+		pool->done = CreateEvent(NULL, TRUE, FALSE, NULL);
+	#else
+		pthread_mutex_init(&pool->lock, NULL);
+		pthread_cond_init(&pool->work, NULL);
+		pthread_cond_init(&pool->done, NULL);
+	#endif
+	
+	/* if a thread can not be started the pool just has fewer workers */
+	for (i = 0; i < threads; ++i) {
+		#ifdef _WIN32
+			pool->threads[i] = (HANDLE)_beginthreadex(NULL, 0, thread_pool_worker, pool, 0, NULL);
+			if (!pool->threads[i])
+				break;
+		#else
+			if (pthread_create(&pool->threads[i], NULL, thread_pool_worker, pool))
+				break;
+		#endif
+	}
+	pool->num_threads = i;
+	
+	return pool;
+}
+
+
+/*
+ *	Stop the workers and free the pool.
+ *	Jobs still queued are run first.
+ */
+void thread_pool_free(struct thread_pool_t* pool) {
+	struct thread_job_t* job = NULL;
+	int i = 0;
+	
+	if (!pool)
+		return;
+	
+	/* finish anything left over */
+	while ((job = thread_pool_next_job(pool)))
+		thread_pool_run_job(pool, job);
+	
+	POOL_LOCK(pool);
+	pool->quit = 1;
+	#ifdef _WIN32
+		ReleaseSemaphore(pool->work, pool->num_threads, NULL);
+	#else
+		pthread_cond_broadcast(&pool->work);
+	#endif
+	POOL_UNLOCK(pool);
+	
+	for (i = 0; i < pool->num_threads; ++i) {
+		#ifdef _WIN32
+			WaitForSingleObject(pool->threads[i], INFINITE);
+			CloseHandle(pool->threads[i]);
+		#else
+			pthread_join(pool->threads[i], NULL);
+		#endif
+	}
+	
+	#ifdef _WIN32
+		CloseHandle(pool->work);
+		CloseHandle(pool->done);
+		DeleteCriticalSection(&pool->lock);
+	#else
+		pthread_cond_destroy(&pool->done);
+		pthread_cond_destroy(&pool->work);
+		pthread_mutex_destroy(&pool->lock);
+	#endif
+	
+	free(pool);
+}
+
+
+/*
+ *	Queue a job in the given group.
+ *
+ *	If the job can not be queued it is run right away.
+ */
+void thread_pool_add(struct thread_pool_t* pool, struct thread_group_t* group, thread_job_func_t func, void* arg) {
+	struct thread_job_t* job = NULL;
+	
+	if (pool)
+		job = (struct thread_job_t*)malloc(sizeof(struct thread_job_t));
+	if (!job) {
+		func(arg);
+		return;
+	}
+	
+	job->next = NULL;
+	job->func = func;
+	job->arg = arg;
+	job->group = group;
+	
+	POOL_LOCK(pool);
+	
+	if (pool->tail)
+		pool->tail->next = job;
+	else
+		pool->head = job;
+	pool->tail = job;
+	++group->pending;
+	
+	#ifdef _WIN32
+		ReleaseSemaphore(pool->work, 1, NULL);
+	#else
+		pthread_cond_signal(&pool->work);
+	#endif
+	
+	POOL_UNLOCK(pool);
+}
+
+
+/*
+ *	Wait for every job in the group to finish.
+ *	Queued jobs are run by the waiting thread in the meantime.
+ */
+void thread_pool_wait(struct thread_pool_t* pool, struct thread_group_t* group) {
+	struct thread_job_t* job = NULL;
+	
+	if (!pool)
+		return;
+	
+	POOL_LOCK(pool);
+	
+	while (group->pending) {
+		if (pool->head) {
+			/* help out */
+			job = pool->head;
+			pool->head = job->next;
+			if (!pool->head)
+				pool->tail = NULL;
+			
+			POOL_UNLOCK(pool);
+			thread_pool_run_job(pool, job);
+			POOL_LOCK(pool);
+			
+			continue;
+		}
+		
+		/* the rest of the group is running on the workers */
+		#ifdef _WIN32
+			ResetEvent(pool->done);
+			POOL_UNLOCK(pool);
+			WaitForSingleObject(pool->done, INFINITE);
+			POOL_LOCK(pool);
+		#else
+			pthread_cond_wait(&pool->done, &pool->lock);
+		#endif
+	}
+	
+	POOL_UNLOCK(pool);
+}
+
+
+/*
+ *	Return how many jobs of the group have not finished yet
+ *	without waiting for them.
+ */
+int thread_pool_pending(struct thread_pool_t* pool, struct thread_group_t* group) {
+	int pending = 0;
+	
+	if (!pool)
+		return group->pending;
+	
+	POOL_LOCK(pool);
+	pending = group->pending;
+	POOL_UNLOCK(pool);
+	
+	return pending;
+}
+
+
+/*
+ *	Return the number of worker threads in the pool.
+ */
+int thread_pool_threads(struct thread_pool_t* pool) {
+	return (pool ? pool->num_threads : 0);
+}
+
+
+/*
+ *	Return the number of CPUs in the system.
+ */
+int cpu_count() {
+	int cpus = 1;
+	
+	#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		cpus = (int)info.dwNumberOfProcessors;
+	#else
+		cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	#endif
+	
+	return ((cpus > 0) ? cpus : 1);
+}
+
+
+/*
+ *	Take the next job off the queue, NULL if there is none.
+ */
+static struct thread_job_t* thread_pool_next_job(struct thread_pool_t* pool) {
+	struct thread_job_t* job = NULL;
+	
+	POOL_LOCK(pool);
+	
+	job = pool->head;
+	if (job) {
+		pool->head = job->next;
+		if (!pool->head)
+			pool->tail = NULL;
+	}
+	
+	POOL_UNLOCK(pool);
+	
+	return job;
+}
+
+
+/*
+ *	Run a job and tell anyone waiting on its group.
+ */
+static void thread_pool_run_job(struct thread_pool_t* pool, struct thread_job_t* job) {
+	job->func(job->arg);
+	
+	POOL_LOCK(pool);
+	
+	if (!--job->group->pending) {
+		#ifdef _WIN32
+			SetEvent(pool->done);
+		#else
+			pthread_cond_broadcast(&pool->done);
+		#endif
+	}
+	
+	POOL_UNLOCK(pool);
+	
+	free(job);
+}
+
+
+/*
+ *	Worker thread - run jobs until the pool is freed.
+ */
+#ifdef _WIN32
+static unsigned __stdcall thread_pool_worker(void* arg) {
+#else
+static void* thread_pool_worker(void* arg) {
+#endif
+	struct thread_pool_t* pool = (struct thread_pool_t*)arg;
+	struct thread_job_t* job = NULL;
+	
+	for (;;) {
+		#ifdef _WIN32
+			WaitForSingleObject(pool->work, INFINITE);
+			POOL_LOCK(pool);
+		#else
+			POOL_LOCK(pool);
+			while (!pool->head && !pool->quit)
+				pthread_cond_wait(&pool->work, &pool->lock);
+		#endif
+		
+		if (pool->quit && !pool->head) {
+			POOL_UNLOCK(pool);
+			break;
+		}
+		
+		/* the job may have been taken by a waiting thread */
+		job = pool->head;
+		if (job) {
+			pool->head = job->next;
+			if (!pool->head)
+				pool->tail = NULL;
+		}
+		
+		POOL_UNLOCK(pool);
+		
+		if (job)
+			thread_pool_run_job(pool, job);
+	}
+	
+	return 0;
+}
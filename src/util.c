@@ -21,11 +21,22 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <malloc.h>
 #include "definitions.h"
 #include "util.h"
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+#endif
+
 /*
  *	Get the path to the given file.
  *	Returns an allocated string.
@@ -152,3 +163,189 @@ char* format_path_for_os(char* path) {
 	return path;
 }
 
+
+/*
+ *	Map an entire file into memory for reading.
+ *	The length of the file is stored in len.
+ *
+ *	Where mmap() is available the file is mapped read-only,
+ *	otherwise the whole file is read in with a single fread().
+ *
+ *	Returns NULL on failure.  Release with unmap_file().
+ */
+void* map_file(char* file, long* len) {
+	void* ptr = NULL;
+
+	#ifdef _WIN32
+		FILE* fptr = fopen(file, "rb");
+		if (!fptr)
+			return NULL;
+
+		fseek(fptr, 0, SEEK_END);
+		*len = ftell(fptr);
+		fseek(fptr, 0, SEEK_SET);
+
+		if (*len > 0) {
+			ptr = malloc(*len);
+			if (ptr && (fread(ptr, *len, 1, fptr) != 1)) {
+				free(ptr);
+				ptr = NULL;
+			}
+		}
+
+		fclose(fptr);
+	#else
+		struct stat st;
+		int fd = open(file, O_RDONLY);
+		if (fd < 0)
+			return NULL;
+
+		if (!fstat(fd, &st) && (st.st_size > 0)) {
+			*len = (long)st.st_size;
+			ptr = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (ptr == MAP_FAILED)
+				ptr = NULL;
+		}
+
+		/* the mapping stays valid after the descriptor is closed */
+		close(fd);
+	#endif
+
+	return ptr;
+}
+
+
+/*
+ *	Release a file mapped by map_file().
+ */
+void unmap_file(void* ptr, long len) {
+	if (!ptr)
+		return;
+
+	#ifdef _WIN32
+		free(ptr);
+		len = 0;	/* get rid of unused variable warning */
+	#else
+		munmap(ptr, len);
+	#endif
+}
+
+
+/*
+ *	Get the size and modification time of a file.
+ *	Returns 1 on success, 0 if the file does not exist.
+ */
+int file_stamp(char* file, unsigned int* size, unsigned int* mtime) {
+	struct stat st;
+
+	if (stat(file, &st))
+		return 0;
+
+	*size = (unsigned int)st.st_size;
+	*mtime = (unsigned int)st.st_mtime;
+
+	return 1;
+}
+
+
+/*
+ *	Create a temporary file next to file and open it for writing.
+ *	No other process or thread writing the same file will pick the
+ *	same name.  The name is put in tmp_file, which needs room for
+ *	TEMP_FILE_EXTRA more characters than file.
+ *
+ *	Returns NULL if the file can not be created.
+ */
+FILE* open_temp_file(char* file, char* tmp_file) {
+	#ifdef _WIN32
+		sprintf(tmp_file, "%s.%lu.%lu.tmp", file, (unsigned long)GetCurrentProcessId(), (unsigned long)GetCurrentThreadId());
+		return fopen(tmp_file, "wb");
+	#else
+		FILE* fptr = NULL;
+		int fd = 0;
+		
+		sprintf(tmp_file, "%s.XXXXXX", file);
+		fd = mkstemp(tmp_file);
+		if (fd == -1)
+			return NULL;
+		
+		/* mkstemp() only lets the owner read it */
+		fchmod(fd, 0644);
+		
+		fptr = fdopen(fd, "wb");
+		if (!fptr) {
+			close(fd);
+			remove(tmp_file);
+		}
+		return fptr;
+	#endif
+}
+
+
+/*
+ *	32 bit FNV-1a hash of a block of memory.
+ *
+ *	http://www.isthe.com/chongo/tech/comp/fnv/
+ */
+unsigned int hash_fnv1a(const void* data, long len) {
+	const byte* ptr = (const byte*)data;
+	unsigned int h = 2166136261u;
+
+	while (len-- > 0) {
+		h ^= *ptr++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+
+/*
+ *	32 bit MurmurHash3 of a block of memory.  Nothing like
+ *	FNV-1a, so together they make a 64 bit hash.
+ *
+ *	https://github.com/aappleby/smhasher
+ */
+unsigned int hash_murmur3(const void* data, long len, unsigned int seed) {
+	const byte* ptr = (const byte*)data;
+	unsigned int h = seed;
+	unsigned int k = 0;
+	long i = 0;
+	
+	for (i = 0; (i + 4) <= len; i += 4, ptr += 4) {
+		k = (ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((unsigned int)ptr[3] << 24));
+		k *= 0xcc9e2d51u;
+		k = ((k << 15) | (k >> 17));
+		k *= 0x1b873593u;
+		
+		h ^= k;
+		h = ((h << 13) | (h >> 19));
+		h = ((h * 5) + 0xe6546b64u);
+	}
+	
+	/* the last 1 to 3 bytes */
+	k = 0;
+	switch (len & 3) {
+		case 3:
+			k ^= (ptr[2] << 16);
+			/* fall through */
+		case 2:
+			k ^= (ptr[1] << 8);
+			/* fall through */
+		case 1:
+			k ^= ptr[0];
+			k *= 0xcc9e2d51u;
+			k = ((k << 15) | (k >> 17));
+			k *= 0x1b873593u;
+			h ^= k;
+	}
+	
+	h ^= (unsigned int)len;
+	h ^= (h >> 16);
+	h *= 0x85ebca6bu;
+	h ^= (h >> 13);
+	h *= 0xc2b2ae35u;
+	h ^= (h >> 16);
+	
+	return h;
+}
@@ -39,7 +39,12 @@
 #include <malloc.h>
 #include <string.h>
 #include "md3_parse.h"
+#include "md3_decode.h"
+#include "md3_frame_cache.h"
+#include "arena.h"
 #include "tga.h"
+#include "mipmap.h"
+#include "tga_compress.h"
 #include "util.h"
 #include "world.h"
 
@@ -48,7 +53,16 @@
 struct world_t* g_world = NULL;
 
 static int get_next_frame(struct md3_anim_state_t* as);
+static void world_lerp_model(struct md3_model_t* m, double now);
 static void _rotate_model(enum MD3_BODY_PARTS type, int axis, float degree, int absolute);
+static int upload_texture(struct world_t* wptr, struct world_texture_t* t);
+static void upload_levels(struct tga_t* tga, int first, int last);
+static void world_trim_textures(struct world_t* wptr, long needed);
+static void world_texture_used(struct world_t* wptr, struct world_texture_t* t);
+static void world_texture_key(char* name, char* key, int size);
+static struct world_texture_name_t* world_find_texture_name(struct world_t* wptr, char* key);
+static struct world_texture_t* world_find_texture(struct world_t* wptr, struct tga_t* text, int same);
+static int world_same_texture(struct world_texture_t* t, struct tga_t* text);
 
 
 /*
@@ -69,6 +83,23 @@ struct world_t* world_init() {
 	/* setup the main light */
 	init_light(&w->light[0]);
 	
+	/* build the shared normal table before any model is loaded */
+	md3_decode_init();
+	
+	/* same for the mipmap color tables */
+	mipmap_init();
+	
+	/* texture bookkeeping nodes are carved out of a pool */
+	pool_init(&w->text_pool, sizeof(struct world_texture_t), WORLD_TEXTURE_POOL_CHUNK);
+	pool_init(&w->text_name_pool, sizeof(struct world_texture_name_t), WORLD_TEXTURE_POOL_CHUNK);
+	w->texture_budget = TEXTURE_GPU_BUDGET;
+	
+	/*
+	 *	One loader thread per CPU so models can be
+	 *	loaded while the GUI thread keeps rendering.
+	 */
+	w->pool = thread_pool_create(cpu_count());
+	
 	return w;
 }
 
@@ -79,6 +110,7 @@ struct world_t* world_init() {
 void world_free(struct world_t* wptr) {
 	struct world_link_models_t* mnext = NULL;
 	struct world_texture_t* tnext = NULL; 
+	struct world_texture_name_t* tname = NULL;
 	
 	/* free all the models */
 	while (wptr->models) {
@@ -91,12 +123,19 @@ void world_free(struct world_t* wptr) {
 	while (wptr->texts) {
 		free_tga(wptr->texts->text);
 		free(wptr->texts->name);
+		for (tname = wptr->texts->names; tname; tname = tname->sibling)
+			free(tname->name);
 		
 		tnext = wptr->texts->next;
-		free(wptr->texts);
 		wptr->texts = tnext;
 	}
 	
+	/* the texture nodes all come from the pools */
+	pool_destroy(&wptr->text_pool);
+	pool_destroy(&wptr->text_name_pool);
+	
+	thread_pool_free(wptr->pool);
+	
 	free(wptr);
 }
 
@@ -105,7 +144,8 @@ void world_free(struct world_t* wptr) {
  *	Add a model to the world.
  */
 void world_add_model(struct world_t* wptr, struct md3_model_t* mptr, int root) {
-	struct world_link_models_t* add = (struct world_link_models_t*)malloc(sizeof(struct world_link_models_t));
+	/* the node was allocated from the model's arena when it was loaded */
+	struct world_link_models_t* add = mptr->world_link;
 	memset(add, 0, sizeof(struct world_link_models_t));
 	
 	add->model = mptr;
@@ -142,7 +182,7 @@ void world_del_model(struct world_t* wptr, struct md3_model_t* mptr) {
 
 			wptr->model_triangles -= del->model->total_triangles;
 			
-			free(del);
+			/* the node itself is freed along with the model's arena */
 			return;
 		}
 		last = del;
@@ -183,24 +223,77 @@ void world_delink_model(struct world_t* wptr, struct md3_model_t* mptr) {
 
 /*
  *	Cache a texture.
+ *
+ *	If a texture with the same pixels is already loaded under
+ *	another name that one is used instead and tptr is freed.
+ *
+ *	Returns the texture the shader should use.
  */
-void world_add_texture(struct world_t* wptr, struct tga_t* tptr, char* name, struct md3_shader_t* sptr) {
-	struct world_texture_t* add = (struct world_texture_t*)malloc(sizeof(struct world_texture_t));
+struct tga_t* world_add_texture(struct world_t* wptr, struct tga_t* tptr, char* name, struct md3_shader_t* sptr) {
+	struct world_texture_t* add = NULL;
+	struct world_texture_name_t* tname = NULL;
+	char key[1024];
+	
+	world_texture_key(name, key, sizeof(key));
+	
+	/* same pixels as a texture that is already loaded? */
+	add = world_find_texture(wptr, tptr, 1);
+	if (add) {
+		world_texture_used(wptr, add);
+		add->binds++;
+		free_tga(tptr);
+		
+		#ifdef _DEBUG
+		printf("Texture \"%s\" is the same as \"%s\", sharing it (%i models).\n", name, add->name, add->binds);
+		#endif
+	} else {
+		add = (struct world_texture_t*)pool_alloc(&wptr->text_pool);
+		memset(add, 0, sizeof(struct world_texture_t));
+		
+		add->text = tptr;
+		add->name = strdup(name);
+		add->binds = 1;
+		add->gl_text_id = 0;
+		add->gl_text_bound = 0;
+		add->upload_next = NULL;
+		add->queued = 1;
 		
-	add->text = tptr;
-	add->name = strdup(name);
-	add->binds = 1;
-	add->gl_text_id = 0;
-	add->gl_text_bound = 0;
+		/* add to front of list */
+		add->next = wptr->texts;
+		if (wptr->texts)
+			wptr->texts->prev = add;
+		wptr->texts = add;
+		
+		/* index it by its pixels */
+		add->content_next = wptr->text_contents[tptr->hash & (WORLD_TEXTURE_HASH_SIZE - 1)];
+		wptr->text_contents[tptr->hash & (WORLD_TEXTURE_HASH_SIZE - 1)] = add;
+		
+		/* and to the back of the upload queue */
+		if (wptr->upload_tail)
+			wptr->upload_tail->upload_next = add;
+		else
+			wptr->upload_queue = add;
+		wptr->upload_tail = add;
+	}
+	
+	/* index it by name */
+	if (!world_find_texture_name(wptr, key)) {
+		tname = (struct world_texture_name_t*)pool_alloc(&wptr->text_name_pool);
+		tname->texture = add;
+		tname->name = strdup(key);
+		tname->hash = hash_fnv1a(key, strlen(key));
+		tname->next = wptr->text_names[tname->hash & (WORLD_TEXTURE_HASH_SIZE - 1)];
+		wptr->text_names[tname->hash & (WORLD_TEXTURE_HASH_SIZE - 1)] = tname;
+		tname->sibling = add->names;
+		add->names = tname;
+	}
 	
 	if (sptr) {
 		sptr->gl_text_id = &add->gl_text_id;
 		sptr->gl_text_bound = &add->gl_text_bound;
 	}
 	
-	/* add to front of list */
-	add->next = wptr->texts;
-	wptr->texts = add;
+	return add->text;
 }
 
 
@@ -208,32 +301,79 @@ void world_add_texture(struct world_t* wptr, struct tga_t* tptr, char* name, str
  *	Delete the texture from the world.
  */
 void world_del_texture(struct world_t* wptr, struct tga_t* text) {
-	struct world_texture_t* del = wptr->texts;
-	struct world_texture_t* last = NULL;
-	while (del) {
-		if (del->text == text) {
-			/* delink this one */
-			if (last)
-				last->next = del->next;
-			if (wptr->texts == del)
-				wptr->texts = del->next;
-
-			#ifdef _DEBUG
-			printf("Texture \"%s\" deleted (GL unbind id %i).\n", del->name, del->gl_text_id);
-			#endif
-			
-			/* tell GL to unbind the texture */
-			glDeleteTextures(1, &del->gl_text_id);
-			
-			/* unload the texture */
-			free_tga(del->text);			
-			free(del);
-			
-			return;
+	struct world_texture_t* del = NULL;
+	struct world_texture_t** link = NULL;
+	struct world_texture_name_t* tname = NULL;
+	struct world_texture_name_t** nlink = NULL;
+	struct world_texture_t* q = NULL;
+	
+	del = world_find_texture(wptr, text, 0);
+	if (!del)
+		return;
+	
+	/* delink this one */
+	if (del->prev)
+		del->prev->next = del->next;
+	else
+		wptr->texts = del->next;
+	if (del->next)
+		del->next->prev = del->prev;
+	
+	for (link = &wptr->text_contents[text->hash & (WORLD_TEXTURE_HASH_SIZE - 1)]; *link; link = &(*link)->content_next) {
+		if (*link == del) {
+			*link = del->content_next;
+			break;
 		}
-		last = del;
-		del = del->next;
 	}
+	
+	/* and every name it was loaded as */
+	while (del->names) {
+		tname = del->names;
+		del->names = tname->sibling;
+		
+		for (nlink = &wptr->text_names[tname->hash & (WORLD_TEXTURE_HASH_SIZE - 1)]; *nlink; nlink = &(*nlink)->next) {
+			if (*nlink == tname) {
+				*nlink = tname->next;
+				break;
+			}
+		}
+		
+		free(tname->name);
+		pool_free(&wptr->text_name_pool, tname);
+	}
+	
+	if (del->unused)
+		world_texture_used(wptr, del);
+	
+	/* it was never uploaded */
+	if (del->queued) {
+		if (wptr->upload_queue == del)
+			wptr->upload_queue = del->upload_next;
+		for (q = wptr->upload_queue; q; q = q->upload_next) {
+			if (q->upload_next == del) {
+				q->upload_next = del->upload_next;
+				break;
+			}
+		}
+		if (wptr->upload_tail == del)
+			wptr->upload_tail = q;
+	}
+
+	#ifdef _DEBUG
+	printf("Texture \"%s\" deleted (GL unbind id %i).\n", del->name, del->gl_text_id);
+	#endif
+	
+	/* tell GL to unbind the texture */
+	if (del->gl_text_id)
+		glDeleteTextures(1, &del->gl_text_id);
+	if (wptr->gl_bound_text == del->gl_text_id)
+		wptr->gl_bound_text = 0;
+	wptr->texture_bytes -= del->gpu_bytes;
+	
+	/* unload the texture */
+	free_tga(del->text);
+	free(del->name);
+	pool_free(&wptr->text_pool, del);
 }
 
 
@@ -241,21 +381,17 @@ void world_del_texture(struct world_t* wptr, struct tga_t* text) {
  *	Tell the world another model needs this texture.
  */
 void world_using_texture(struct world_t* wptr, struct tga_t* text) {
-	struct world_texture_t* t = wptr->texts;
-		
-	while (t) {
-		if (t->text == text) {
-			/* texture found */
-			t->binds++;
-
-			#ifdef _DEBUG
-			printf("Texture \"%s\" now being used by %i models.\n", t->name, t->binds);
-			#endif
+	struct world_texture_t* t = world_find_texture(wptr, text, 0);
+	
+	if (!t)
+		return;
+	
+	world_texture_used(wptr, t);
+	t->binds++;
 
-			return;
-		}
-		t = t->next;
-	}
+	#ifdef _DEBUG
+	printf("Texture \"%s\" now being used by %i models.\n", t->name, t->binds);
+	#endif
 }
 
 
@@ -263,25 +399,36 @@ void world_using_texture(struct world_t* wptr, struct tga_t* text) {
  *	Tell the world some model that was using this texture no longer needs it.
  */
 void world_not_using_texture(struct world_t* wptr, struct tga_t* text) {
-	struct world_texture_t* t = wptr->texts;
-		
-	while (t) {
-		if (t->text == text) {
-			/* texture found */
-			t->binds--;
-
-			#ifdef _DEBUG
-			printf("Texture \"%s\" now being used by %i models.\n", t->name, t->binds);
-			#endif
-			
-			if (!t->binds)
-				/* no models are using this texture anymore, kill it */
-				world_del_texture(wptr, text);
+	struct world_texture_t* t = world_find_texture(wptr, text, 0);
+	
+	if (!t)
+		return;
+	
+	t->binds--;
 
-			return;
-		}
-		t = t->next;
+	#ifdef _DEBUG
+	printf("Texture \"%s\" now being used by %i models.\n", t->name, t->binds);
+	#endif
+	
+	if (t->binds)
+		return;
+	
+	/* no models are using this texture anymore, keep it in GL while it fits */
+	if (!t->gl_text_bound) {
+		world_del_texture(wptr, text);
+		return;
 	}
+	
+	t->unused = 1;
+	t->lru_next = NULL;
+	t->lru_prev = wptr->unused_tail;
+	if (wptr->unused_tail)
+		wptr->unused_tail->lru_next = t;
+	else
+		wptr->unused_texts = t;
+	wptr->unused_tail = t;
+	
+	world_trim_textures(wptr, 0);
 }
 
 
@@ -292,22 +439,115 @@ void world_not_using_texture(struct world_t* wptr, struct tga_t* text) {
  *	Returns pointer to tga_t structure if it exists.
  */
 struct tga_t* world_texture_cached(struct world_t* wptr, char* name, struct md3_shader_t* sptr) {
-	struct world_texture_t* t = wptr->texts;
+	struct world_texture_name_t* tname = NULL;
+	char key[1024];
+	
+	world_texture_key(name, key, sizeof(key));
+	
+	tname = world_find_texture_name(wptr, key);
+	if (!tname)
+		return NULL;
+	
+	/* texture found */
+	if (sptr) {
+		sptr->gl_text_id = &tname->texture->gl_text_id;
+		sptr->gl_text_bound = &tname->texture->gl_text_bound;
+	}
+	
+	return tname->texture->text;
+}
+
+
+/*
+ *	Upload textures waiting in the upload queue, oldest first,
+ *	until budget milliseconds have gone by.
+ *
+ *	Called before each frame is drawn so textures a model just
+ *	loaded are in OpenGL before the model is drawn, rather than
+ *	being uploaded by apply_texture() halfway through drawing.
+ *	At least one texture is uploaded so a texture bigger than
+ *	the budget still gets its turn.
+ *
+ *	A texture goes to the back of the queue after each part
+ *	of it is uploaded, so every texture waiting gets its
+ *	placeholder before any gets its bigger levels.
+ */
+void world_upload_textures(struct world_t* wptr, double budget) {
+	struct world_texture_t* t = NULL;
+	double start = 0;
+	
+	if (!wptr->upload_queue)
+		return;
+	start = get_time_in_ms();
+	
+	while (wptr->upload_queue) {
+		t = wptr->upload_queue;
+		wptr->upload_queue = t->upload_next;
+		if (!wptr->upload_queue)
+			wptr->upload_tail = NULL;
+		t->upload_next = NULL;
+		t->queued = 0;
 		
-	while (t) {
-		if (!strcmp(name, t->name)) {
-			/* texture found */
-			if (sptr) {
-				sptr->gl_text_id = &t->gl_text_id;
-				sptr->gl_text_bound = &t->gl_text_bound;
-			}
-			
-			return t->text;
+		if (!upload_texture(wptr, t)) {
+			t->queued = 1;
+			if (wptr->upload_tail)
+				wptr->upload_tail->upload_next = t;
+			else
+				wptr->upload_queue = t;
+			wptr->upload_tail = t;
 		}
-		t = t->next;
+		
+		if ((get_time_in_ms() - start) >= budget)
+			break;
 	}
+}
+
+
+/*
+ *	Set the most bytes of textures to keep in OpenGL.
+ *	Textures no model uses are dropped to get under it.
+ */
+void world_set_texture_budget(struct world_t* wptr, long budget) {
+	wptr->texture_budget = budget;
+	world_trim_textures(wptr, 0);
+}
+
+
+/*
+ *	Forget every texture in OpenGL, ie: because the GL context
+ *	was lost.  Textures in use are uploaded again (after reading
+ *	their pixels back in), the rest are dropped.
+ */
+void world_textures_lost(struct world_t* wptr) {
+	struct world_texture_t* t = wptr->texts;
+	struct world_texture_t* next = NULL;
 	
-	return NULL;
+	wptr->gl_bound_text = 0;
+	
+	for (; t; t = next) {
+		next = t->next;
+		
+		/* the ids belong to the old context */
+		t->gl_text_id = 0;
+		t->gl_text_bound = 0;
+		wptr->texture_bytes -= t->gpu_bytes;
+		t->gpu_bytes = 0;
+		
+		if (t->unused) {
+			world_del_texture(wptr, t->text);
+			continue;
+		}
+		
+		if (!t->queued) {
+			t->queued = 1;
+			t->upload_next = NULL;
+			if (wptr->upload_tail)
+				wptr->upload_tail->upload_next = t;
+			else
+				wptr->upload_queue = t;
+			wptr->upload_tail = t;
+		}
+	}
 }
 
 
@@ -377,6 +617,11 @@ void set_model_animation(enum MD3_ANIMATIONS id) {
 		/* set starting frame for the animation */
 		m->anim_state.frame = g_world->anims[m->anim_state.id].first_frame;
 		m->anim_state.next_frame = get_next_frame(&m->anim_state);
+		m->anim_state.last_time = g_world->update_time;
+		m->anim_state.t = 0;
+		
+		/* decode the frames of the animation now rather than while it plays */
+		md3_frame_cache_prefetch(m, g_world->anims[m->anim_state.id].first_frame, g_world->anims[m->anim_state.id].last_frame);
 	}
 
 	/* legs */
@@ -393,6 +638,10 @@ void set_model_animation(enum MD3_ANIMATIONS id) {
 		/* set starting frame for the animation */
 		m->anim_state.frame = g_world->anims[m->anim_state.id].first_frame;
 		m->anim_state.next_frame = get_next_frame(&m->anim_state);
+		m->anim_state.last_time = g_world->update_time;
+		m->anim_state.t = 0;
+		
+		md3_frame_cache_prefetch(m, g_world->anims[m->anim_state.id].first_frame, g_world->anims[m->anim_state.id].last_frame);
 	}
 }
 
@@ -424,35 +673,95 @@ void world_stop_model_animation(int model_types) {
 
 
 /*
- *	Update the animation state for the given model.
+ *	The update phase.
+ *
+ *	Advance the animation of every model from one sample of the
+ *	clock.  Called once for each frame displayed, before anything
+ *	is drawn, so drawing only ever reads the animation state and
+ *	every pass of a frame draws the same pose.
+ *
+ *	With WORLD_UPDATE_STEP the key frames advance in fixed steps
+ *	of that many milliseconds, whatever the frame rate.  Only t
+ *	follows the clock between the steps.
  */
-void world_tick_model(struct md3_model_t* m) {
-	double now, elapsed, frame_duration;
+void world_update(struct world_t* wptr) {
+	struct world_link_models_t* lm = NULL;
+	double now = get_time_in_ms();
+	
+	#ifdef WORLD_UPDATE_STEP
+		/* do not catch up on time nothing was drawn in (ie: the window was hidden) */
+		if ((now - wptr->update_time) > WORLD_UPDATE_MAX_LAG)
+			wptr->update_time = now;
+		
+		for (; (wptr->update_time + WORLD_UPDATE_STEP) <= now; wptr->update_time += WORLD_UPDATE_STEP) {
+			for (lm = wptr->models; lm; lm = lm->next)
+				world_tick_model(lm->model, (wptr->update_time + WORLD_UPDATE_STEP));
+		}
+	#else
+		wptr->update_time = now;
+		for (lm = wptr->models; lm; lm = lm->next)
+			world_tick_model(lm->model, now);
+	#endif
+	
+	/* interpolate to the time being drawn */
+	for (lm = wptr->models; lm; lm = lm->next)
+		world_lerp_model(lm->model, now);
+}
+
+
+/*
+ *	Advance the key frames of the given model up to the time now.
+ */
+void world_tick_model(struct md3_model_t* m, double now) {
+	double frame_duration;
 	
 	if (!m->anim_state.animated)
 		/* if we are not in a state of animation t should not change */
 		return;
 
-	now = get_time_in_ms();
-	elapsed = (now - m->anim_state.last_time);
 	frame_duration = (1000.0 / g_world->anims[m->anim_state.id].fps);
 	
-	#ifdef USE_INTERPOLATION
-	if (WORLD_IS_SET(ENGINE_INTERPOLATE))
-		m->anim_state.t = (elapsed / frame_duration);
-	#endif
-
-	if (elapsed >= frame_duration) {
+	while ((now - m->anim_state.last_time) >= frame_duration) {
 		/* tick the frame to the next key frame */
-		m->anim_state.frame++;
 		m->anim_state.frame = m->anim_state.next_frame;
 		m->anim_state.next_frame = get_next_frame(&m->anim_state);
-		m->anim_state.last_time = now;
 		m->anim_state.t = 0;
+		
+		/*
+		 *	Keep what is left over so the animation runs at the same
+		 *	speed at any frame rate, unless it is hopelessly behind.
+		 */
+		m->anim_state.last_time += frame_duration;
+		if ((now - m->anim_state.last_time) > WORLD_UPDATE_MAX_LAG)
+			m->anim_state.last_time = now;
 	}
 }
 
 
+/*
+ *	Set how far the given model is between its key frames at the time now.
+ */
+static void world_lerp_model(struct md3_model_t* m, double now) {
+	if (!m->anim_state.animated)
+		return;
+	
+	#ifdef USE_INTERPOLATION
+	if (WORLD_IS_SET(ENGINE_INTERPOLATE)) {
+		double t;
+		
+		/* past the next key frame until the next step reaches it */
+		t = ((now - m->anim_state.last_time) / (1000.0 / g_world->anims[m->anim_state.id].fps));
+		m->anim_state.t = (float)((t < 1.0) ? t : 1.0);
+		return;
+	}
+	#else
+	(void)now;	/* get rid of unused variable warning */
+	#endif
+	
+	m->anim_state.t = 0;
+}
+
+
 /*
  *	Get the next frame for the animation state.
  */
@@ -649,42 +958,29 @@ void apply_material(struct material_t* material) {
 
 /*
  *	Bind the texture within OpenGL.
+ *
+ *	Textures are uploaded by world_upload_textures() before the
+ *	frame is drawn, one that is still waiting its turn is drawn
+ *	untextured rather than stalling the frame to upload it.
+ *
+ *	Surfaces sharing a texture (ie: an atlas, see atlas.h)
+ *	one after another only bind it once.
  */
 void apply_texture(struct md3_shader_t* sptr) {
+	unsigned int id = 0;
+	
 	/* if no texture exists, it cannot be bound */
 	if (!sptr->texture)
 		return;
 	
-	if (sptr->gl_text_bound && !*sptr->gl_text_bound) {
-		/*
-		 *	Bind the texture within OpenGL if it has not already been done.
-		 *	This speeds up rendering.
-		 */
-		glGenTextures(1, sptr->gl_text_id);
-		glBindTexture(GL_TEXTURE_2D, *sptr->gl_text_id);
-		glTexImage2D(
-					GL_TEXTURE_2D,
-					0,
-					sptr->texture->gl_compontents,
-					sptr->texture->header.width,
-					sptr->texture->header.height,
-					0,
-					sptr->texture->gl_format,
-					GL_UNSIGNED_BYTE,
-					sptr->texture->img
-		);
-		
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-		
-		*sptr->gl_text_bound = 1;
-	}
+	if (sptr->gl_text_bound && *sptr->gl_text_bound)
+		id = *sptr->gl_text_id;
 	
 	/* Apply the texture */
-	glBindTexture(GL_TEXTURE_2D, *sptr->gl_text_id);
+	if (id != g_world->gl_bound_text) {
+		glBindTexture(GL_TEXTURE_2D, id);
+		g_world->gl_bound_text = id;
+	}
 }
 
 
@@ -756,3 +1052,240 @@ void world_register_mirror(struct world_t* w, double* clip_plane, float* origin,
 		w->mirrors = m;		
 	}
 }
+
+
+/*
+ *	Upload the next part of a texture to OpenGL.
+ *
+ *	The first time, the pixels are read back in if they were freed
+ *	and the small mipmap levels (TEXTURE_PLACEHOLDER_SIZE and down)
+ *	are uploaded so the texture can be drawn right away.  Unused
+ *	textures are dropped to make room for all of it and if that is
+ *	not enough the biggest mipmap levels are left out.
+ *
+ *	After that each call uploads the next bigger level and lets
+ *	OpenGL draw with it.  Once every level is in OpenGL the pixels
+ *	are freed since only OpenGL needs them.
+ *
+ *	Returns 1 if the texture is all in OpenGL.
+ */
+static int upload_texture(struct world_t* wptr, struct world_texture_t* t) {
+	struct tga_t* tga = t->text;
+	int first = 0;
+	
+	if (!tga || (t->gl_text_bound && (t->level <= t->lod)))
+		return 1;
+	
+	if (!tga->img && !tga_reload(tga, t->name)) {
+		printf("WARNING: Texture \"%s\" could not be read again, it will not be drawn.\n", t->name);
+		return 1;
+	}
+	
+	if (!t->gl_text_bound) {
+		world_trim_textures(wptr, tga_gpu_size(tga, 0));
+		for (t->lod = 0; (t->lod < TEXTURE_MAX_LOD_BIAS) && (t->lod < tga->num_mips); ++t->lod) {
+			if ((wptr->texture_bytes + tga_gpu_size(tga, t->lod)) <= wptr->texture_budget)
+				break;
+		}
+		
+		#ifdef _DEBUG
+		if (t->lod)
+			printf("Texture \"%s\" is over the texture budget, leaving out %i mipmap levels.\n", t->name, t->lod);
+		#endif
+		
+		/* the placeholder */
+		for (first = t->lod; first < tga->num_mips; ++first) {
+			if (((tga->header.width >> first) <= TEXTURE_PLACEHOLDER_SIZE) && ((tga->header.height >> first) <= TEXTURE_PLACEHOLDER_SIZE))
+				break;
+		}
+		
+		glGenTextures(1, &t->gl_text_id);
+		glBindTexture(GL_TEXTURE_2D, t->gl_text_id);
+		wptr->gl_bound_text = t->gl_text_id;
+		
+		upload_levels(tga, first, tga->num_mips);
+		
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, ((tga->num_mips > t->lod) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tga->num_mips);
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+		
+		t->gl_text_bound = 1;
+		t->level = first;
+	} else if (t->level > t->lod) {
+		/* the next bigger level */
+		glBindTexture(GL_TEXTURE_2D, t->gl_text_id);
+		wptr->gl_bound_text = t->gl_text_id;
+		
+		upload_levels(tga, (t->level - 1), (t->level - 1));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, --t->level);
+	}
+	
+	wptr->texture_bytes -= t->gpu_bytes;
+	t->gpu_bytes = tga_gpu_size(tga, t->level);
+	wptr->texture_bytes += t->gpu_bytes;
+	
+	if (t->level > t->lod)
+		return 0;
+	
+	if (!tga->keep_pixels)
+		tga_free_pixels(tga);
+	return 1;
+}
+
+
+/*
+ *	Upload levels first to last of a texture
+ *	to the same levels of the bound OpenGL texture.
+ */
+static void upload_levels(struct tga_t* tga, int first, int last) {
+	GLint alignment = 4;
+	int level = 0;
+	int w = 0;
+	int h = 0;
+	
+	/* rows of the small mipmap levels are not 4 byte aligned */
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	
+	if (tga->compressed)
+		tga_upload_compressed(tga, first, last);
+	else {
+		for (level = 0, w = tga->header.width, h = tga->header.height; level <= last; ++level) {
+			if (level >= first)
+				glTexImage2D(GL_TEXTURE_2D, level, tga->gl_compontents, w, h, 0, tga->gl_format, GL_UNSIGNED_BYTE, (level ? tga->mips[level - 1] : tga->img));
+			w = ((w > 1) ? (w / 2) : 1);
+			h = ((h > 1) ? (h / 2) : 1);
+		}
+	}
+	
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+
+/*
+ *	Drop textures no model uses, least recently used first,
+ *	until another needed bytes fit in the texture budget.
+ */
+static void world_trim_textures(struct world_t* wptr, long needed) {
+	while (wptr->unused_texts && ((wptr->texture_bytes + needed) > wptr->texture_budget)) {
+		#ifdef _DEBUG
+		printf("Texture \"%s\" is unused and over the texture budget.\n", wptr->unused_texts->name);
+		#endif
+		
+		world_del_texture(wptr, wptr->unused_texts->text);
+	}
+}
+
+
+/*
+ *	Take a texture off the unused list since a model uses it again.
+ */
+static void world_texture_used(struct world_t* wptr, struct world_texture_t* t) {
+	if (!t->unused)
+		return;
+	
+	if (t->lru_prev)
+		t->lru_prev->lru_next = t->lru_next;
+	else
+		wptr->unused_texts = t->lru_next;
+	if (t->lru_next)
+		t->lru_next->lru_prev = t->lru_prev;
+	else
+		wptr->unused_tail = t->lru_prev;
+	
+	t->lru_prev = NULL;
+	t->lru_next = NULL;
+	t->unused = 0;
+}
+
+
+/*
+ *	Normalize a texture path into key so the same file always
+ *	has the same name; lower case, '/' between directories and
+ *	no empty or "." directories.
+ */
+static void world_texture_key(char* name, char* key, int size) {
+	char* out = key;
+	char* end = (key + size - 1);
+	char c = 0;
+	int at_dir = 0;
+	
+	for (; *name && (out < end); ++name) {
+		c = *name;
+		if (c == '\\')
+			c = '/';
+		
+		if (c == '/') {
+			/* "//" */
+			if (at_dir)
+				continue;
+			at_dir = 1;
+			
+			/* "/./" or a leading "./" */
+			if ((out > key) && (out[-1] == '.') && (((out - 1) == key) || (out[-2] == '/'))) {
+				--out;
+				continue;
+			}
+		} else
+			at_dir = 0;
+		
+		*out++ = (char)(((c >= 'A') && (c <= 'Z')) ? (c - 'A' + 'a') : c);
+	}
+	*out = '\0';
+}
+
+
+/*
+ *	Find the name node of a normalized texture path.
+ */
+static struct world_texture_name_t* world_find_texture_name(struct world_t* wptr, char* key) {
+	struct world_texture_name_t* tname = NULL;
+	unsigned int hash = hash_fnv1a(key, strlen(key));
+	
+	for (tname = wptr->text_names[hash & (WORLD_TEXTURE_HASH_SIZE - 1)]; tname; tname = tname->next) {
+		if ((tname->hash == hash) && !strcmp(tname->name, key))
+			return tname;
+	}
+	
+	return NULL;
+}
+
+
+/*
+ *	Find the world node of a texture.
+ *
+ *	If same is set any texture with the same pixels
+ *	is found, otherwise only text itself.
+ */
+static struct world_texture_t* world_find_texture(struct world_t* wptr, struct tga_t* text, int same) {
+	struct world_texture_t* t = NULL;
+	
+	if (!text)
+		return NULL;
+	
+	for (t = wptr->text_contents[text->hash & (WORLD_TEXTURE_HASH_SIZE - 1)]; t; t = t->content_next) {
+		if ((t->text == text) || (same && world_same_texture(t, text)))
+			return t;
+	}
+	
+	return NULL;
+}
+
+
+/*
+ *	Check if a world texture has the same pixels as text.
+ *
+ *	Once uploaded a texture's pixels are freed, its hashes then
+ *	have to do rather than reading its file again in the middle
+ *	of a frame.
+ */
+static int world_same_texture(struct world_texture_t* t, struct tga_t* text) {
+	if (!t->text->img)
+		return tga_same_hash(t->text, text);
+	
+	return tga_same(t->text, text);
+}